@@ -0,0 +1,232 @@
+#ifndef _BATCHTREE_H_
+#define _BATCHTREE_H_
+
+////////////////////////////////////////////////////////////////
+//
+// Batch engine for building and analyzing many binary trees at once.
+//
+// BinaryTree allocates every node on the heap and keeps its own all_nodes
+// vector, which costs more than the work itself when there are millions of
+// small trees. TreeBatch builds a whole batch of level-order inputs(the same
+// format as BinaryTree::BuildTree()) into shared arenas instead:
+//
+//  1. The trees are split into one contiguous range per thread, balanced by
+//  the number of tokens. Each thread builds its range into its own arena(a
+//  vector<TreeNode> reserved up front), so there is no per-node allocation
+//  and no sharing between threads.
+//
+//  2. Analyze() runs the requested analyses(traversals, IsBST, HasLoop and
+//  PathSum) with the same thread partitioning, and writes the results into
+//  columns: one flat vector per analysis, indexed by tree or by the node
+//  offsets of the trees.
+//
+// Example:
+//  TreeBatch batch(4);
+//  batch.Build(trees);
+//  BatchResults res;
+//  batch.Analyze(BATCH_PREORDER|BATCH_IS_BST,0,res);
+//  // preorder traversal of tree i: res.preorder[res.offsets[i]..res.offsets[i+1])
+//  // tree i is a BST: res.is_bst[i]
+//
+// Build with -pthread.
+//
+////////////////////////////////////////////////////////////////
+
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include "binarytree.h"
+
+using namespace std;
+
+// Analyses supported by TreeBatch::Analyze()
+enum BatchAnalysis {
+    BATCH_PREORDER=1,
+    BATCH_INORDER=2,
+    BATCH_POSTORDER=4,
+    BATCH_IS_BST=8,
+    BATCH_HAS_LOOP=16,
+    BATCH_PATH_SUM=32
+};
+
+//
+// Columnar results of TreeBatch::Analyze(). Traversals of tree i are stored in
+// [offsets[i], offsets[i+1]) of the traversal columns, other columns have one
+// entry per tree. Columns of analyses that are not requested are left empty.
+//
+struct BatchResults {
+    vector<size_t> offsets;  // offset of each tree in the traversal columns
+    vector<int> preorder;
+    vector<int> inorder;
+    vector<int> postorder;
+    vector<char> is_bst;     // char instead of bool: written by many threads
+    vector<char> has_loop;
+    vector<int> path_sums;   // number of root-to-leaf paths equal to the sum
+};
+
+class TreeBatch {
+public:
+    TreeBatch(int threads=0) {
+        nthreads=(threads>0) ? threads : thread::hardware_concurrency();
+        if(nthreads<=0)
+            nthreads=1;
+    }
+
+    //
+    // Build all trees from their level-order representations, such as
+    // {1,2,3,#,#,4,#,#,5}, where "#" means invalid node. Throws
+    // invalid_argument if a token is neither "#" nor a number, like
+    // BuildTree(); the batch is empty afterwards.
+    //
+    void Build(vector<vector<string> >& trees) {
+        arenas.clear();
+        arenas.resize(nthreads);
+        roots.assign(trees.size(),NULL);
+        offsets.assign(trees.size()+1,0);
+
+        // Split trees into ranges with about the same number of tokens
+        size_t total=0;
+        for(auto& t:trees)
+            total+=t.size();
+        first.assign(nthreads+1,trees.size());
+        first[0]=0;
+        size_t acc=0;
+        int th=1;
+        for(size_t i=0;i<trees.size() && th<nthreads;++i) {
+            while(th<nthreads && acc>=total*th/nthreads)
+                first[th++]=i;
+            acc+=trees[i].size();
+        }
+
+        try {
+            RunThreads([&](int t) {
+                vector<TreeNode>& arena=arenas[t];
+                size_t valid=0;
+                for(size_t i=first[t];i<first[t+1];++i)
+                    for(auto& s:trees[i])
+                        if(s!="#")
+                            valid++;
+                arena.reserve(valid);   // nodes must never move once linked
+
+                for(size_t i=first[t];i<first[t+1];++i) {
+                    size_t before=arena.size();
+                    roots[i]=BuildInto(trees[i],arena);
+                    offsets[i+1]=arena.size()-before; // node count for now
+                }
+            });
+        } catch(...) {
+            arenas.clear();
+            roots.clear();
+            offsets.assign(1,0);
+            first.assign(nthreads+1,0);
+            throw;
+        }
+
+        for(size_t i=0;i<trees.size();++i)
+            offsets[i+1]+=offsets[i];
+    }
+
+    int NumTrees() { return roots.size(); }
+
+    TreeNode* GetRoot(int i) { return roots[i]; }
+
+    int NumNodes(int i) { return offsets[i+1]-offsets[i]; }
+
+    //
+    // Run the analyses given by a mask of BatchAnalysis flags on all trees.
+    // sum is only used by BATCH_PATH_SUM.
+    //
+    void Analyze(int analyses, int sum, BatchResults& res) {
+        size_t n=roots.size();
+        res.offsets=offsets;
+        res.preorder.assign((analyses&BATCH_PREORDER) ? offsets[n] : 0,0);
+        res.inorder.assign((analyses&BATCH_INORDER) ? offsets[n] : 0,0);
+        res.postorder.assign((analyses&BATCH_POSTORDER) ? offsets[n] : 0,0);
+        res.is_bst.assign((analyses&BATCH_IS_BST) ? n : 0,0);
+        res.has_loop.assign((analyses&BATCH_HAS_LOOP) ? n : 0,0);
+        res.path_sums.assign((analyses&BATCH_PATH_SUM) ? n : 0,0);
+
+        RunThreads([&](int t) {
+            BinaryTree algo;    // owns no nodes, only used for its algorithms
+            TraversalWorkspace ws;  // reused for all trees of this thread
+            for(size_t i=first[t];i<first[t+1];++i) {
+                TreeNode* rt=roots[i];
+                if(analyses&BATCH_PREORDER)
+                    algo.PreorderTraversal(rt,ws,res.preorder.begin()+offsets[i]);
+                if(analyses&BATCH_INORDER)
+                    algo.InorderTraversal(rt,ws,res.inorder.begin()+offsets[i]);
+                if(analyses&BATCH_POSTORDER)
+                    algo.PostorderTraversal(rt,ws,res.postorder.begin()+offsets[i]);
+                // Use the uncached check, trees are only checked once
+                if(analyses&BATCH_IS_BST)
+                    res.is_bst[i]=algo.IsBSTHelper(rt,INT_MIN,INT_MAX);
+                if(analyses&BATCH_HAS_LOOP)
+                    res.has_loop[i]=algo.HasLoop(rt,ws);
+                if(analyses&BATCH_PATH_SUM)
+                    res.path_sums[i]=algo.PathSum(rt,sum).size();
+            }
+        });
+    }
+
+private:
+    //
+    // Call fn(t) for every thread t, the last one runs on the calling thread.
+    // An exception thrown by fn is caught in its thread and rethrown once all
+    // threads have been joined.
+    //
+    template<typename Fn>
+    void RunThreads(Fn fn) {
+        vector<exception_ptr> errors(nthreads);
+        auto run=[&](int t) {
+            try {
+                fn(t);
+            } catch(...) {
+                errors[t]=current_exception();
+            }
+        };
+        vector<thread> workers;
+        for(int t=0;t<nthreads-1;++t)
+            workers.push_back(thread(run,t));
+        run(nthreads-1);
+        for(auto& w:workers)
+            w.join();
+        for(auto& e:errors)
+            if(e)
+                rethrow_exception(e);
+    }
+
+    //
+    // Build a tree into the arena. In the level-order representation the
+    // children of the k-th valid node are the tokens 2k+1 and 2k+2, so nodes
+    // are appended in level order without a queue. The arena must have enough
+    // capacity for all nodes.
+    //
+    static TreeNode* BuildInto(vector<string>& t, vector<TreeNode>& arena) {
+        if(t.empty() || t[0]=="#")
+            return NULL;
+
+        size_t base=arena.size();
+        arena.push_back(TreeNode(stoi(t[0])));
+        for(size_t j=1;j<t.size();++j) {
+            size_t p=base+(j-1)/2; // the parent of token j
+            if(p>=arena.size())
+                break;  // tokens without parent are ignored
+            if(t[j]=="#")
+                continue;
+            arena.push_back(TreeNode(stoi(t[j])));
+            if(j%2==1)
+                arena[p].left=&arena.back();
+            else
+                arena[p].right=&arena.back();
+        }
+        return &arena[base];
+    }
+
+    int nthreads;
+    vector<size_t> first;   // thread t owns trees [first[t], first[t+1])
+    vector<vector<TreeNode> > arenas; // per-thread node storage
+    vector<TreeNode*> roots;
+    vector<size_t> offsets; // prefix sums of the node counts
+};
+
+#endif // _BATCHTREE_H_
@@ -69,9 +69,51 @@
 // at every level are connected from left to right.
 //
 // 7. Check if a binary tree is Binary Search Tree
-// The strategy is to recursively check (1) if the maximum value in the left subtree
-// is smaller than the root node, and (2) if the minimum value in the right subtree
-// is greater than the root node.
+// The strategy is to check (1) if the maximum value in the left subtree is smaller
+// than the root node, and (2) if the minimum value in the right subtree is greater
+// than the root node. The min/max of each subtree are cached, so after changing a
+// few nodes(and calling MarkDirty() on them) only the root-to-node paths are checked
+// again. Only the root and the saved versions of the tree are cached.
+//
+// 8. Persistent Tree
+// Several versions of a tree can be kept at the same time. SetValue() and InsertBST()
+// never change an existing node; they copy the nodes on the root-to-node path, share
+// all other nodes with the old version, and return the root of the new version.
+// Snapshot() records a version in O(1). Since the nodes of a version are never
+// changed, all read-only functions(traversals, IsSameTree(), PathSum(), IsBST(), ...)
+// work on any version, and IsBST() reuses the cached results of the shared subtrees.
+// Functions that modify nodes in place(BuildCycleTree(), Convert2DL()) must not be
+// used on shared nodes. DropVersion() forgets a version, and Collect() releases the
+// nodes no longer reachable from the root or a saved version.
+//
+// 9. Traversal Workspace
+// The traversals, PrintTree(), IsSameTree(), HasLoop(), Convert2DL() and
+// BuildCycleTree() have overloads taking a TraversalWorkspace, which holds the
+// stacks, queues and visited set they need. Reusing one workspace(sized by
+// MakeWorkspace()) across calls avoids allocations in tight loops. The traversal
+// overloads write to an output iterator, such as a pointer into a caller-owned
+// buffer or a back_inserter of a reused vector. A buffer for a traversal of the
+// root needs TraceLength() entries, which is more than NumNodes() once subtrees
+// are shared.
+//
+// 10. Sharing Identical Subtrees
+// CompactDAG() detects identical subtrees(same shape and values) by hash-consing
+// bottom-up and keeps one node for all copies, so the tree becomes a DAG. The
+// read-only functions(traversals, IsSameTree(), PathSum(), IsBST(), ...) give the
+// same results on the DAG. In this mode HasLoop() distinguishes sharing from
+// cycles: only a link back to an ancestor is reported as a loop.
+//
+// 11. Node Relayout
+// After many builds, updates and conversions the nodes of a tree are scattered
+// over the heap. Relayout() moves all nodes into one contiguous block in preorder,
+// BFS or van Emde Boas order and rewrites all links, so that traversals touch
+// consecutive memory again.
+//
+// 12. Tree Metrics
+// Analyze<Metrics>() computes a set of metrics(size, height, width, min, max, sum,
+// BST, balance, leaves, diameter and path sums) in a single DFS instead of one
+// traversal per metric. The set is a template argument, so unused metrics cost
+// nothing. A tree with a loop is reported as such instead of being measured.
 //
 // Version 1, May 25th by Bo Yang(bonny95@gmail.com).
 // Version 1.1, May 30th by Bo Yang, added function IsSameTree() and Zigzag traversal.
@@ -79,6 +121,13 @@
 // Version 1.3, Aug 16th by Bo Yang, added functions BuildCycleTree() and HasLoop().
 // Version 1.4, Sep 2nd by Bo Yang, added function Convert2DL().
 // Version 1.5, Oct 9th by Bo Yang, added functions IsBST() and IsBSTHelper().
+// Version 1.6, made IsBST() iterative and incremental, added MarkDirty().
+// Version 1.7, added persistent versions: Snapshot(), SetValue() and InsertBST().
+// Version 1.8, added TraversalWorkspace and overloads that reuse it.
+// Version 1.9, added CompactDAG() to share identical subtrees.
+// Version 1.10, added Relayout() to restore the locality of nodes.
+// Version 1.11, added Analyze() to compute several metrics in one pass.
+// Version 1.12, added DropVersion() and Collect() to release old versions.
 //
 // TODO:
 //  1. Add copy constructor and overload assignment operator=.
@@ -93,6 +142,10 @@
 #include <cstdlib>
 #include <queue>
 #include <list>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
 #include <climits>
@@ -109,18 +162,204 @@ struct TreeNode {
     TreeNode *right;
     TreeNode(int x) : val(x), left(NULL), right(NULL) {}
 };
+
+// Hash of a node address for the open addressing tables
+inline size_t HashNode(TreeNode* node) {
+    uint64_t x=(uint64_t)(uintptr_t)node;
+    x^=x>>33;
+    x*=0xff51afd7ed558ccdULL;
+    x^=x>>33;
+    return (size_t)x;
+}
+
+//
+// Scratch memory of the traversal functions. Passing the same workspace to
+// every call keeps its stacks, queues and visited set between calls, so once
+// it is large enough for a tree the functions make no allocation(apart from
+// the output when not written to a caller-provided buffer). A workspace can be
+// sized up front by BinaryTree::MakeWorkspace() or Reserve().
+//
+struct TraversalWorkspace {
+    vector<TreeNode*> stk;              // DFS stack
+    vector<pair<TreeNode*,bool> > stk2; // DFS stack with a flag per node
+    vector<TreeNode*> q;                // BFS queue, popped by moving a head index
+    vector<TreeNode*> q2;               // second BFS queue
+    vector<pair<int,size_t> > vals;     // <val,index in q>
+
+    // The default workspace allocates nothing until it is used
+    TraversalWorkspace(size_t nodes=0, size_t layers=0) : used(0), gen(1) {
+        if(nodes>0 || layers>0)
+            Reserve(nodes,layers);
+    }
+
+    // Reserve room for a tree of the given number of nodes and layers
+    void Reserve(size_t nodes, size_t layers) {
+        stk.reserve(layers+1);
+        stk2.reserve(2*layers+1);
+        q.reserve(nodes);
+        q2.reserve(nodes);
+        vals.reserve(nodes);
+        if(nodes>0)
+            ReserveVisited(nodes);
+    }
+
+    // Reserve room for the given number of nodes in the visited set. Otherwise
+    // the set is only allocated when it is first used.
+    void ReserveVisited(size_t nodes) {
+        size_t cap=16;
+        while(cap<2*nodes)
+            cap<<=1;
+        if(cap>slots.size())
+            Rehash(cap);
+    }
+
+    // Empty the visited set in O(1)
+    void ResetVisited() {
+        used=0;
+        if(++gen==0) {  // stamps wrapped around
+            fill(stamps.begin(),stamps.end(),0);
+            gen=1;
+        }
+    }
+
+    // Add a node to the visited set, return false if it was already there
+    bool Visit(TreeNode* node) {
+        size_t h=Slot(node);
+        if(stamps[h]==gen)
+            return false;
+        Insert(h,node,1);
+        return true;
+    }
+
+    // State of a node in the visited set, 0 if it is not there
+    int State(TreeNode* node) {
+        size_t h=Slot(node);
+        return (stamps[h]==gen) ? states[h] : 0;
+    }
+
+    // Add a node to the visited set with a nonzero state, or update its state
+    void SetState(TreeNode* node, int state) {
+        size_t h=Slot(node);
+        if(stamps[h]!=gen)
+            Insert(h,node,state);
+        else
+            states[h]=state;
+    }
+
+private:
+    // The slot holding node, or the free slot where it would be inserted
+    size_t Slot(TreeNode* node) {
+        if(2*(used+1)>slots.size())
+            Rehash(max((size_t)16,2*slots.size()));
+        size_t mask=slots.size()-1;
+        size_t h=HashNode(node)&mask;
+        while(stamps[h]==gen && slots[h]!=node)
+            h=(h+1)&mask;
+        return h;
+    }
+
+    void Insert(size_t h, TreeNode* node, int state) {
+        slots[h]=node;
+        stamps[h]=gen;
+        states[h]=state;
+        used++;
+    }
+
+    // Move the visited set to a table of cap slots
+    void Rehash(size_t cap) {
+        vector<TreeNode*> old_slots;
+        vector<unsigned> old_stamps;
+        vector<unsigned char> old_states;
+        old_slots.swap(slots);
+        old_stamps.swap(stamps);
+        old_states.swap(states);
+        slots.assign(cap,NULL);
+        stamps.assign(cap,0);
+        states.assign(cap,0);
+        unsigned old_gen=gen;
+        gen=1;
+        used=0;
+        for(size_t i=0;i<old_slots.size();++i)
+            if(old_stamps[i]==old_gen)
+                Insert(Slot(old_slots[i]),old_slots[i],old_states[i]);
+    }
+
+    // Open addressing set of nodes, a slot is used if its stamp equals gen
+    vector<TreeNode*> slots;
+    vector<unsigned> stamps;
+    vector<unsigned char> states;
+    size_t used;
+    unsigned gen;
+};
  
+// Metrics computed by BinaryTree::Analyze(), combined as a bit mask
+enum TreeMetric {
+    METRIC_SIZE=1<<0,
+    METRIC_HEIGHT=1<<1,
+    METRIC_WIDTH=1<<2,
+    METRIC_MIN=1<<3,
+    METRIC_MAX=1<<4,
+    METRIC_SUM=1<<5,
+    METRIC_BST=1<<6,
+    METRIC_BALANCE=1<<7,
+    METRIC_LEAVES=1<<8,
+    METRIC_DIAMETER=1<<9,
+    METRIC_PATH_SUM=1<<10,
+    METRIC_ALL=(1<<11)-1
+};
+
+// Result of BinaryTree::Analyze(), metrics not requested are left 0
+struct TreeMetrics {
+    size_t size;        // number of nodes
+    int height;         // number of layers
+    size_t width;       // maximum number of nodes in a layer
+    int min;
+    int max;
+    long long sum;      // sum of all values
+    bool is_bst;
+    int balance_factor; // height of the left subtree - height of the right subtree of the root
+    bool balanced;      // balance factor of every node is -1, 0 or 1
+    size_t leaves;
+    int diameter;       // number of edges on the longest path between two nodes
+    size_t path_sums;   // number of root-to-leaf paths whose sum equals the given sum
+    bool has_loop;      // always checked: a node links back to an ancestor, all other metrics are 0
+
+    TreeMetrics() : size(0), height(0), width(0), min(0), max(0), sum(0), is_bst(false),
+        balance_factor(0), balanced(false), leaves(0), diameter(0), path_sums(0), has_loop(false) {}
+};
+
+// Node orders supported by BinaryTree::Relayout()
+enum NodeLayout {
+    LAYOUT_PREORDER,    // depth first, left before right
+    LAYOUT_BFS,         // level by level
+    LAYOUT_VEB          // van Emde Boas: recursively split the levels in halves
+};
+
 class BinaryTree {
 public:
-    BinaryTree() { root=NULL;layers=0; }
-    BinaryTree(vector<string>& t) { BuildTree(t); }
+    BinaryTree() { root=NULL;layers=0;trace_len=0;shared_subtrees=false; }
+    BinaryTree(vector<string>& t) { root=NULL;layers=0;trace_len=0;shared_subtrees=false; BuildTree(t); }
     ~BinaryTree() {
         for(auto& node:all_nodes)
-            delete node;
+            FreeNode(node);
     }
 
     TreeNode* GetRoot() { return root; }
 
+    // Number of nodes owned by this tree. After CompactDAG() a shared node is
+    // counted once.
+    size_t NumNodes() { return all_nodes.size(); }
+
+    // Number of values a traversal of the root writes, i.e. the number of nodes
+    // with shared subtrees counted once per parent. Size traversal buffers with
+    // this. For another root(such as a version) use Analyze<METRIC_SIZE>(rt).size.
+    size_t TraceLength() { return trace_len; }
+
+    // A workspace large enough for the traversals of this tree
+    TraversalWorkspace MakeWorkspace() {
+        return TraversalWorkspace(max(trace_len,all_nodes.size()),layers);
+    }
+
     //
     // Preorder Traversal:
     //  (i) Visit the root, (ii) Traverse the left subtree, and 
@@ -128,27 +367,37 @@ public:
     //
     vector<int> PreorderTraversal(TreeNode *rt) {
         vector<int> trace;
-        stack<TreeNode*> st;
+        TraversalWorkspace ws;
+        PreorderTraversal(rt,ws,back_inserter(trace));
+        return trace;
+    }
+
+    // Write the preorder traversal to out, using the stack of the workspace.
+    // Returns the end of the output.
+    template<typename OutputIt>
+    OutputIt PreorderTraversal(TreeNode *rt, TraversalWorkspace& ws, OutputIt out) {
+        vector<TreeNode*>& st=ws.stk;
+        st.clear();
         TreeNode *root = rt;
         while(root!=NULL) {
-            trace.push_back(root->val); // Visit the root
+            *out++=root->val; // Visit the root
             if(root->left!=NULL) {  // Traverse the left subtree
                 TreeNode* tmp=root;
                 root=root->left;
                 if(tmp->right!=NULL)
-                    st.push(tmp->right);    // store the root of the right subtree
+                    st.push_back(tmp->right);    // store the root of the right subtree
             } else if(root->right!=NULL) {
                 root=root->right;
             } else {
                 if(st.empty()) {
                     root=NULL;
                 } else {
-                    root=st.top();
-                    st.pop();
+                    root=st.back();
+                    st.pop_back();
                 }
             }
         } // end of while
-        return trace;
+        return out;
     }
 
     //
@@ -159,30 +408,30 @@ public:
     //
     vector<int> InorderTraversal(TreeNode *rt) {
         vector<int> trace;
-        stack<TreeNode*> st;
+        TraversalWorkspace ws;
+        InorderTraversal(rt,ws,back_inserter(trace));
+        return trace;
+    }
+
+    // Write the inorder traversal to out, using the stack of the workspace.
+    // Returns the end of the output.
+    template<typename OutputIt>
+    OutputIt InorderTraversal(TreeNode *rt, TraversalWorkspace& ws, OutputIt out) {
+        vector<TreeNode*>& st=ws.stk;
+        st.clear();
         TreeNode *root = rt;
-        while(root!=NULL) {
+        while(root!=NULL || !st.empty()) {
             // Find the left-most node
-            if(root->left!=NULL) {
-                TreeNode * tmp=root;
+            while(root!=NULL) {
+                st.push_back(root);  // store the root of the right subtree
                 root=root->left;
-                tmp->left=NULL;
-                st.push(tmp);   // store the root of the right subtree
-            } else if(root->right!=NULL) {
-                // Handle the right subtree
-                trace.push_back(root->val); // Visit leftmost node
-                root=root->right;
-            } else {
-                trace.push_back(root->val); // Visit leaf/root node
-                if(st.empty()) {
-                    root=NULL;
-                } else {
-                    root=st.top();
-                    st.pop();
-                }
             }
+            root=st.back();
+            st.pop_back();
+            *out++=root->val; // Visit leftmost/root node
+            root=root->right;   // Handle the right subtree
         }
-        return trace;
+        return out;
     }
 
     // 
@@ -195,32 +444,33 @@ public:
     //
     vector<int> PostorderTraversal(TreeNode *rt) {
         vector<int> trace;
-        stack<TreeNode*> st;
-        TreeNode *root = rt;
-        while(root!=NULL) {
-            // Find the left-most node
-            if(root->left!=NULL) {
-                TreeNode * tmp=root;
-                root=root->left;
-                tmp->left=NULL;
-                st.push(tmp);   // store the root of the right subtree
-            } else if(root->right!=NULL) {
-                TreeNode * tmp=root;
-                root=root->right;
-                tmp->left=NULL;
-                tmp->right=NULL;
-                st.push(tmp);   // store the root
-            } else {
-                trace.push_back(root->val); // Print root at last
-                if(st.empty()) {
-                    root=NULL;
-                } else {
-                    root=st.top();
-                    st.pop();
-                }
+        TraversalWorkspace ws;
+        PostorderTraversal(rt,ws,back_inserter(trace));
+        return trace;
+    }
+
+    // Write the postorder traversal to out, using the stack of the workspace.
+    // Returns the end of the output.
+    template<typename OutputIt>
+    OutputIt PostorderTraversal(TreeNode *rt, TraversalWorkspace& ws, OutputIt out) {
+        vector<pair<TreeNode*,bool> >& st=ws.stk2; // <node, subtrees already pushed>
+        st.clear();
+        if(rt!=NULL)
+            st.push_back(make_pair(rt,false));
+        while(!st.empty()) {
+            TreeNode* root=st.back().first;
+            if(st.back().second) {
+                *out++=root->val; // Print root at last
+                st.pop_back();
+                continue;
             }
+            st.back().second=true;
+            if(root->right!=NULL)
+                st.push_back(make_pair(root->right,false));
+            if(root->left!=NULL)
+                st.push_back(make_pair(root->left,false));
         }
-        return trace;
+        return out;
     }
 
     //
@@ -330,6 +580,15 @@ public:
         if(t.empty())
             return NULL;
 
+        InvalidateBST();
+        layers=0;
+        shared_subtrees=false;
+        trace_len=0;
+        if(t[0]=="#") {   // empty tree
+            root=NULL;
+            return NULL;
+        }
+        size_t owned=all_nodes.size();
         root=new TreeNode(-1);
         TreeNode* tree=root;
         queue<TreeNode*> q; // store nodes of next layer
@@ -342,8 +601,10 @@ public:
         // second layer, and so on.
         int idx=0;
         int nodes_cur_layer=1;
+        // Tokens after the last layer with a valid node have no parent, and are
+        // ignored.
         vector<string>::iterator it=t.begin(); 
-        while(idx<t.size()){
+        while(idx<t.size() && nodes_cur_layer>0){
             int nodes_next_layer=0; // all nodes, including #s
             int vi=0;   // index of valid nodes in next layer
             for(int i=0;i<nodes_cur_layer;++i) {
@@ -387,6 +648,7 @@ public:
             layers++;
         }
 
+        trace_len=all_nodes.size()-owned;
         return root;    // root of the tree
     }
 
@@ -394,25 +656,32 @@ public:
     // Print binary tree level by level
     // 
     void PrintTree(TreeNode *root) {
-        queue<TreeNode*> q;
-        TreeNode* tmp=root;
-        q.push(tmp);
+        TraversalWorkspace ws;
+        PrintTree(root,ws);
+    }
+
+    void PrintTree(TreeNode *root, TraversalWorkspace& ws) {
+        vector<TreeNode*>& q=ws.q; // nodes are popped by moving head
+        q.clear();
+        if(root==NULL)
+            return;
+        q.push_back(root);
+        size_t head=0;
         int nodes_cur_layer=1; // # of nodes in current layer
         int nodes_next_layer=0; // # of nodes in next layer
         while(nodes_cur_layer>0) {
             for(int i=0;i<nodes_cur_layer;++i) {
-                tmp=q.front();
-                q.pop();
+                TreeNode* tmp=q[head++];
 
                 cout<<tmp->val<<"(";
 
                 if(tmp->left!=NULL) {
-                    q.push(tmp->left);
+                    q.push_back(tmp->left);
                     nodes_next_layer++;
                     cout<<"/";
                 }
                 if(tmp->right!=NULL) {
-                    q.push(tmp->right);
+                    q.push_back(tmp->right);
                     nodes_next_layer++;
                     cout<<"\\";
                 }
@@ -429,15 +698,23 @@ public:
     // identical and the nodes have the same value.
     //
     bool IsSameTree(TreeNode *p, TreeNode *q) {
+        TraversalWorkspace ws;
+        return IsSameTree(p,q,ws);
+    }
+
+    bool IsSameTree(TreeNode *p, TreeNode *q, TraversalWorkspace& ws) {
         bool same_tree=true;
-        queue<TreeNode*> qp;
-        queue<TreeNode*> qq;
+        vector<TreeNode*>& qp=ws.q;
+        vector<TreeNode*>& qq=ws.q2;
+        qp.clear();
+        qq.clear();
+        size_t head=0;  // both queues are popped together
         int cur_layer_nodes;
         int next_layer_nodes=0;
         if(p!=NULL && q!=NULL) {
             cur_layer_nodes=1;
-            qp.push(p);
-            qq.push(q);
+            qp.push_back(p);
+            qq.push_back(q);
         } else if(p==NULL && q==NULL) {
             return true;
         } else {
@@ -448,10 +725,9 @@ public:
         while(cur_layer_nodes>0) {
             next_layer_nodes=0;
             for(int i=0;i<cur_layer_nodes;++i) {
-                TreeNode* tp=qp.front();
-                qp.pop();
-                TreeNode* tq=qq.front();
-                qq.pop();
+                TreeNode* tp=qp[head];
+                TreeNode* tq=qq[head];
+                head++;
 
                 if((tp->val!=tq->val) || (tp->left==NULL) && (tq->left!=NULL) || (tp->left!=NULL) && (tq->left==NULL) || (tp->right==NULL) && (tq->right!=NULL) || (tp->right!=NULL) && (tq->right==NULL)) {
                     same_tree=false;
@@ -459,14 +735,14 @@ public:
                 }
 
                 if(tp->left!=NULL) {
-                    qp.push(tp->left);
-                    qq.push(tq->left);
+                    qp.push_back(tp->left);
+                    qq.push_back(tq->left);
                     next_layer_nodes++;
                 }
 
                 if(tp->right!=NULL) {
-                    qp.push(tp->right);
-                    qq.push(tq->right);
+                    qp.push_back(tp->right);
+                    qq.push_back(tq->right);
                     next_layer_nodes++;
                 }
             } // end for
@@ -487,52 +763,39 @@ public:
        if(root==NULL)
            return all_paths;
 
-       queue<TreeNode*> layer;
-       unordered_map<TreeNode*,vector<int> > path_to_now;
-       unordered_map<TreeNode*,int> sum_to_now;
+       // Level-order traversal. Every visit of a node is a step, which records
+       // the sum to now and the step of its parent, so the path to a leaf is
+       // rebuilt by following the parent steps. The steps also serve as the
+       // queue. A node reached through several parents(shared subtrees) gets
+       // one step per path.
+       struct Step {
+           TreeNode* node;
+           int parent;     // index of the parent step, -1 for the root
+           int sum_to_now;
+       };
+       vector<Step> steps;
+       Step first={root,-1,root->val};
+       steps.push_back(first);
+       for(size_t head=0;head<steps.size();++head) {
+           Step cur=steps[head];
+           TreeNode* node=cur.node;
 
-       if(root->val==sum && root->left==NULL && root->right==NULL) {
-           vector<int> path;
-           path.push_back(root->val);
-           all_paths.push_back(path);
-           return all_paths;
-       }
-
-       layer.push(root);
-       path_to_now[root].push_back(root->val);
-       sum_to_now[root]=root->val;
-       int cur_layer_nodes=1;
-       int next_layer_nodes=0;
-       int cnt=0;
-       while(!layer.empty()) {
-           TreeNode* node=layer.front();
-           layer.pop();
-           cnt++;
-
-           if(sum_to_now[node]==sum && node->left==NULL && node->right==NULL)
-               all_paths.push_back(path_to_now[node]);
+           if(cur.sum_to_now==sum && node->left==NULL && node->right==NULL) {
+               vector<int> path;
+               for(int i=head;i>=0;i=steps[i].parent)
+                   path.push_back(steps[i].node->val);
+               reverse(path.begin(),path.end());
+               all_paths.push_back(path);
+           }
 
            if(node->left!=NULL) {
-                layer.push(node->left);
-                next_layer_nodes++;
-                path_to_now[node->left]=path_to_now[node];
-                path_to_now[node->left].push_back(node->left->val);
-                sum_to_now[node->left]=sum_to_now[node]+node->left->val;
+               Step next={node->left,(int)head,cur.sum_to_now+node->left->val};
+               steps.push_back(next);
            }
 
            if(node->right!=NULL) {
-                layer.push(node->right);
-                next_layer_nodes++;
-                path_to_now[node->right]=path_to_now[node];
-                path_to_now[node->right].push_back(node->right->val);
-                sum_to_now[node->right]=sum_to_now[node]+node->right->val;
-           }
-
-           path_to_now.erase(node);
-           sum_to_now.erase(node);
-           if(cnt==cur_layer_nodes) {
-               cur_layer_nodes=next_layer_nodes;
-               next_layer_nodes=0;
+               Step next={node->right,(int)head,cur.sum_to_now+node->right->val};
+               steps.push_back(next);
            }
        }
 
@@ -568,29 +831,28 @@ public:
     //  Given binary tree {1,2,3,4,#,5,#}, to make a loop, we can add new links {3->2} or {2->5}.
     //
     TreeNode* BuildCycleTree(TreeNode* root, vector<string>& t) {
-        unordered_map<int,TreeNode*> map; // <val,addr>
-
-        // Find all the addresses of tree nodes by level-order(BFS) traversal
-        queue<TreeNode*> q;
-        q.push(root);
-        int nCur=1;
-        while(!q.empty()) {
-            int nNext=0;
-            for(int i=0;i<nCur;++i) {
-                TreeNode* node=q.front();
-                q.pop();
-                map[node->val]=node;
-                if(node->left!=NULL) {
-                    q.push(node->left);
-                    nNext++;
-                }
-                if(node->right!=NULL) {
-                    q.push(node->right);
-                    nNext++;
-                }
-            } // end for
-            nCur=nNext;
-        } // end while
+        TraversalWorkspace ws;
+        return BuildCycleTree(root,t,ws);
+    }
+
+    TreeNode* BuildCycleTree(TreeNode* root, vector<string>& t, TraversalWorkspace& ws) {
+        // Find all the addresses of tree nodes by level-order(BFS) traversal, and
+        // sort them by <val,BFS index>. For equal values the last one wins.
+        vector<TreeNode*>& q=ws.q;
+        vector<pair<int,size_t> >& map=ws.vals; // <val,index in q>
+        q.clear();
+        map.clear();
+        if(root!=NULL)
+            q.push_back(root);
+        for(size_t head=0;head<q.size();++head) {
+            TreeNode* node=q[head];
+            map.push_back(make_pair(node->val,head));
+            if(node->left!=NULL)
+                q.push_back(node->left);
+            if(node->right!=NULL)
+                q.push_back(node->right);
+        } // end for
+        sort(map.begin(),map.end());
 
         // Link nodes and make cycle
         for(auto& str:t) {
@@ -598,12 +860,19 @@ public:
             for(i=0;str[i]!='-';++i);
             int lnode=stoi(str.substr(0,i));
             int rnode=stoi(str.substr(i+2));
-            if(map[lnode]->left==NULL)
-                map[lnode]->left=map[rnode];
-            else if(map[lnode]->right==NULL)
-                map[lnode]->right=map[rnode];
-            else
+            TreeNode* ln=FindByVal(ws,lnode);
+            TreeNode* rn=FindByVal(ws,rnode);
+            if(ln==NULL || rn==NULL) {
+                cerr<<"Error: "<<str<<" links a node not in the tree!"<<endl;
+            } else if(ln->left==NULL) {
+                ln->left=rn;
+                MarkDirty(ln);
+            } else if(ln->right==NULL) {
+                ln->right=rn;
+                MarkDirty(ln);
+            } else {
                 cerr<<"Error: "<<lnode<<" already has two child nodes!"<<endl;
+            }
         }
 
         return root;
@@ -615,30 +884,74 @@ public:
     // has a child node already been accessed before.
     //
     bool HasLoop(TreeNode* root) {
+        TraversalWorkspace ws;
+        return HasLoop(root,ws);
+    }
+
+    bool HasLoop(TreeNode* root, TraversalWorkspace& ws) {
         if(root==NULL)
             return false;
+        if(shared_subtrees)
+            return HasDirectedCycle(root,ws);
 
-        unordered_set<TreeNode*> set; // store nodes have been accessed
-        stack<TreeNode*> st;
-        st.push(root);
+        ws.ResetVisited(); // store nodes have been accessed
+        vector<TreeNode*>& st=ws.stk;
+        st.clear();
+        st.push_back(root);
         while(!st.empty()) {
-            TreeNode* node=st.top();
-            st.pop();
-            unordered_set<TreeNode*>::iterator got=set.find(node);
-            if(got!=set.end())
+            TreeNode* node=st.back();
+            st.pop_back();
+            if(!ws.Visit(node))
                 return true;
-            else
-                set.insert(node);
 
             if(node->left!=NULL)
-                st.push(node->left);
+                st.push_back(node->left);
             if(node->right!=NULL)
-                st.push(node->right);
+                st.push_back(node->right);
 
         }
         return false;
     }
 
+    //
+    // Detect if a DAG contains a cycle. A node reached through two parents is a
+    // shared subtree, not a loop; there is a cycle only if a node links to one
+    // of its ancestors on the current DFS path.
+    //
+    bool HasDirectedCycle(TreeNode* root, TraversalWorkspace& ws) {
+        const int ON_PATH=1, DONE=2;
+        ws.ResetVisited();
+        vector<pair<TreeNode*,bool> >& st=ws.stk2; // <node, children already pushed>
+        st.clear();
+        if(root!=NULL)
+            st.push_back(make_pair(root,false));
+        while(!st.empty()) {
+            TreeNode* node=st.back().first;
+            if(st.back().second) {  // all descendants checked
+                ws.SetState(node,DONE);
+                st.pop_back();
+                continue;
+            }
+            if(ws.State(node)==DONE) {  // shared subtree checked before
+                st.pop_back();
+                continue;
+            }
+            ws.SetState(node,ON_PATH);
+            st.back().second=true;
+            TreeNode* children[2]={node->right,node->left};
+            for(auto& c:children) {
+                if(c==NULL)
+                    continue;
+                int state=ws.State(c);
+                if(state==ON_PATH)
+                    return true;    // link back to an ancestor
+                if(state!=DONE)
+                    st.push_back(make_pair(c,false));
+            }
+        }
+        return false;
+    }
+
     // Convert left-right representation of a bianry tree to down-right(please refer to:
     // http://geeksquiz.com/convert-left-right-representation-bianry-tree-right/).
     //
@@ -677,30 +990,37 @@ public:
     // record the leftmost node as the head of this layer. And after traversing current
     // layer, we also need to link the head of current layer to the head of next layer.
     TreeNode* Convert2DL(TreeNode* root) {
+        TraversalWorkspace ws;
+        return Convert2DL(root,ws);
+    }
+
+    TreeNode* Convert2DL(TreeNode* root, TraversalWorkspace& ws) {
         if(root==NULL)
             return NULL;
+        InvalidateBST();    // almost every node is relinked
 
-        queue<TreeNode*> q;
-        q.push(root);
+        vector<TreeNode*>& q=ws.q; // nodes are popped by moving head
+        q.clear();
+        q.push_back(root);
+        size_t head=0;
         int nCur=1; // number of nodes in current layer
-        TreeNode* head=NULL; // the head node in each layer
-        while(!q.empty()) {
-            head=q.front();
-            TreeNode* cur=head;
+        TreeNode* first=NULL; // the head node in each layer
+        while(head<q.size()) {
+            first=q[head];
+            TreeNode* cur=first;
             int nNext=0; // number of nodes in next layer
             for(int i=0;i<nCur;++i) {
-                TreeNode* n=q.front();
-                q.pop();
+                TreeNode* n=q[head++];
                 if(n->left!=NULL) {
-                    q.push(n->left);
+                    q.push_back(n->left);
                     nNext++;
                 }
                 if(n->right!=NULL) {
-                    q.push(n->right);
+                    q.push_back(n->right);
                     nNext++;
                 }
                 // Link current node to the right of this layer
-                if(n!=head) { 
+                if(n!=first) { 
                     cur->right=n;
                     cur=n;
                     cur->left=NULL;
@@ -708,10 +1028,10 @@ public:
             }
             nCur=nNext;
             cur->right=NULL;
-            if(q.empty())
-                head->left=NULL;
+            if(head==q.size())
+                first->left=NULL;
             else 
-                head->left=q.front(); // point to the head of the next layer
+                first->left=q[head]; // point to the head of the next layer
         }
 
         return root;
@@ -747,36 +1067,850 @@ public:
     //  than the node’s key.
     //  • Both the left and right subtrees must also be binary search trees.
     //
+    // The check is done bottom-up by an iterative postorder traversal: a subtree
+    // is a BST if both of its subtrees are BSTs, the maximum of the left subtree
+    // is smaller than the root and the minimum of the right subtree is greater
+    // than the root. The min, max and validity of every visited subtree are
+    // cached, so a later call only re-walks subtrees invalidated by MarkDirty().
+    // A tree with a loop(a link back to a node on the DFS path) is not a BST.
+    //
+    // The cache is keyed by node address, so it is only kept for the root and
+    // the saved versions of this tree. Any other root(e.g. a tree owned by
+    // another BinaryTree, whose nodes may be freed and their addresses reused)
+    // is checked with a scratch cache that is dropped on return.
+    //
     bool IsBST(TreeNode* root) {
-        return IsBSTHelper(root, INT_MIN, INT_MAX);
+        if(root==NULL)
+            return true;
+        if(root==this->root || find(versions.begin(),versions.end(),root)!=versions.end())
+            return CheckBST(root,bst);
+        BSTCache scratch;
+        return CheckBST(root,scratch);
     }
     
-    // Helper function for checking binary search tree
+    // Helper function for checking binary search tree without using the cache,
+    // i.e. all nodes must lie in the open interval (min, max).
     bool IsBSTHelper(TreeNode* root, int min, int max) {
+        stack<TreeNode*> st;
+        stack<pair<int,int> > bounds;
+        if(root!=NULL) {
+            st.push(root);
+            bounds.push(make_pair(min,max));
+        }
+        while(!st.empty()) {
+            TreeNode* node=st.top();
+            st.pop();
+            int lo=bounds.top().first;
+            int hi=bounds.top().second;
+            bounds.pop();
+
+            if(node->val<=lo || node->val>=hi)
+                return false;
+
+            if(node->right!=NULL) {
+                st.push(node->right);
+                bounds.push(make_pair(node->val,hi));
+            }
+            if(node->left!=NULL) {
+                st.push(node->left);
+                bounds.push(make_pair(lo,node->val));
+            }
+        }
+        return true;
+    }
+
+    //
+    // Tell IsBST() that the value or the child pointers of a node have been
+    // changed. The cached results of the node and all its ancestors are dropped,
+    // so only the root-to-node path is checked again. For a new node, mark its
+    // parent instead.
+    //
+    void MarkDirty(TreeNode* node) {
+        BSTInfo* e=FindBST(bst,node);
+        if(e==NULL)
+            return;
+        e->flags&=~BST_CACHED;
+        // An ancestor is only cached if all of its descendants are
+        for(e=FindBST(bst,e->parent);e!=NULL && (e->flags&BST_CACHED);e=FindBST(bst,e->parent))
+            e->flags&=~BST_CACHED;
+    }
+
+    // Drop all cached results of IsBST()
+    void InvalidateBST() {
+        BSTCache().Swap(bst);
+    }
+
+    //
+    // Hash-consing: share one node between all identical subtrees of the tree
+    // and of all saved versions, turning the tree into a DAG. Subtrees are
+    // visited in postorder, so the children of a node are already canonical
+    // and two subtrees are identical iff their roots have the same value and
+    // the same child pointers. The duplicates are released. Returns the new
+    // root.
+    //
+    // After this, nodes may have several parents: HasLoop() only reports real
+    // cycles, and functions that modify nodes in place must not be used. A tree
+    // with a cycle is left as it is.
+    //
+    TreeNode* CompactDAG() {
+        vector<TreeNode*> starts(versions);
+        starts.push_back(root);
+        TraversalWorkspace ws;
+        for(auto& rt:starts)
+            if(HasDirectedCycle(rt,ws))
+                return root;
+
+        unordered_map<TreeNode*,TreeNode*> canon; // <node,canonical node>
+        unordered_map<NodeKey,TreeNode*,NodeKeyHash> table;
+        unordered_set<TreeNode*> dups;
+        stack<pair<TreeNode*,bool> > st; // <node, children already pushed>
+        for(auto& rt:starts) {
+            if(rt!=NULL && canon.find(rt)==canon.end())
+                st.push(make_pair(rt,false));
+            while(!st.empty()) {
+                TreeNode* node=st.top().first;
+                if(canon.find(node)!=canon.end()) {    // reached before
+                    st.pop();
+                    continue;
+                }
+                if(!st.top().second) {
+                    st.top().second=true;
+                    if(node->right!=NULL)
+                        st.push(make_pair(node->right,false));
+                    if(node->left!=NULL)
+                        st.push(make_pair(node->left,false));
+                    continue;
+                }
+                st.pop();
+
+                if(node->left!=NULL)
+                    node->left=canon[node->left];
+                if(node->right!=NULL)
+                    node->right=canon[node->right];
+                NodeKey key={node->val,node->left,node->right};
+                pair<unordered_map<NodeKey,TreeNode*,NodeKeyHash>::iterator,bool> got=table.insert(make_pair(key,node));
+                canon[node]=got.first->second;
+                if(!got.second)
+                    dups.insert(node);
+            }
+        }
+
+        root=(root!=NULL) ? canon[root] : NULL;
+        for(auto& v:versions)
+            if(v!=NULL)
+                v=canon[v];
+
+        // Release the duplicates
+        size_t k=0;
+        for(size_t i=0;i<all_nodes.size();++i) {
+            if(dups.find(all_nodes[i])!=dups.end())
+                FreeNode(all_nodes[i]);
+            else
+                all_nodes[k++]=all_nodes[i];
+        }
+        all_nodes.resize(k);
+        InvalidateBST();
+        if(!dups.empty())
+            shared_subtrees=true;
+        return root;
+    }
+
+    //
+    // Move all nodes into fresh contiguous storage in the given order, rewrite
+    // left/right, root and the saved versions, and update all_nodes. Nodes that
+    // are visited together then share cache lines and pages again, however
+    // scattered the heap has become.
+    //
+    // Every node is moved exactly once, so trees with loops or shared subtrees
+    // are handled too. The trick is to leave a forwarding pointer in the left
+    // child of each old node once it is copied: a node is already moved iff its
+    // left pointer points into the new storage, and after copying, the child
+    // pointers of the copies are redirected through the old nodes. Only nodes in
+    // all_nodes are moved(they are marked in the visited set of a workspace), so
+    // the new storage holds exactly all_nodes.size() nodes; nodes of another
+    // tree reached through a version stay where they are.
+    //
+    // Preorder and BFS take O(n) time, and the new storage itself serves as the
+    // BFS queue. The vEB order is also placed directly into the new storage:
+    // the top half of the levels first, then the subtrees hanging below them,
+    // which are the children not moved yet of the copies of the top half. This
+    // takes O(n log h) time for a tree of h layers.
+    //
+    // Node pointers held outside this tree are no longer valid afterwards.
+    //
+    void Relayout(NodeLayout order) {
+        size_t n=all_nodes.size();
+        if(n==0)
+            return;
+
+        TraversalWorkspace owned;
+        owned.ReserveVisited(n);
+        for(auto& node:all_nodes)
+            owned.SetState(node,RELAYOUT_OWNED);
+
+        vector<TreeNode> fresh;
+        fresh.reserve(n);   // never reallocated: nodes must not move
+        vector<TreeNode*>& st=owned.stk;
+        vector<pair<TreeNode*,size_t> > depths; // stack of VebHeight()
+        auto place=[&](TreeNode* s) {
+            if(!Movable(s,owned,fresh))
+                return;
+            if(order==LAYOUT_PREORDER) {
+                st.push_back(s);
+                while(!st.empty()) {
+                    TreeNode* node=st.back();
+                    st.pop_back();
+                    if(!Movable(node,owned,fresh))
+                        continue;
+                    TreeNode* copy=MoveTo(node,fresh);
+                    if(copy->right!=NULL)
+                        st.push_back(copy->right);
+                    if(copy->left!=NULL)
+                        st.push_back(copy->left);
+                }
+            } else if(order==LAYOUT_BFS) {
+                size_t head=fresh.size();
+                MoveTo(s,fresh);
+                while(head<fresh.size()) {
+                    TreeNode& copy=fresh[head++];
+                    if(Movable(copy.left,owned,fresh))
+                        MoveTo(copy.left,fresh);
+                    if(Movable(copy.right,owned,fresh))
+                        MoveTo(copy.right,fresh);
+                }
+            } else {
+                VebPlace(s,VebHeight(s,owned,fresh,depths),owned,fresh);
+            }
+        };
+
+        // Nodes reachable from the root come first, then the saved versions,
+        // then any node not reachable from either
+        place(root);
+        for(auto& v:versions)
+            place(v);
+        for(auto& node:all_nodes)
+            place(node);
+        assert(fresh.size()==n);
+
+        // Follow the forwarding pointers
+        for(auto& node:fresh) {
+            if(node.left!=NULL && Moved(node.left,fresh))
+                node.left=node.left->left;
+            if(node.right!=NULL && Moved(node.right,fresh))
+                node.right=node.right->left;
+        }
+        TreeNode* new_root=(root!=NULL && Moved(root,fresh)) ? root->left : root;
+        vector<TreeNode*> new_versions(versions);
+        for(auto& v:new_versions)
+            if(v!=NULL && Moved(v,fresh))
+                v=v->left;
+
+        for(auto& node:all_nodes)
+            FreeNode(node);
+        arena.swap(fresh);  // the old arena is released with fresh
+        for(size_t i=0;i<n;++i)
+            all_nodes[i]=&arena[i];
+        root=new_root;
+        versions=new_versions;
+        InvalidateBST();
+    }
+
+    //
+    // Compute a set of metrics in a single traversal. Metrics is a mask of
+    // TreeMetric flags known at compile time, so the code for metrics not
+    // requested is removed by the compiler. For example:
+    //  TreeMetrics m=bt.Analyze<METRIC_HEIGHT|METRIC_WIDTH>(root);
+    //
+    // The traversal is an iterative DFS. Depth and the sum to now are passed
+    // down on the stack(width, path sums); height, min and max of each subtree
+    // are passed up on a second stack when the subtree is done(height, min/max,
+    // BST, balance, diameter).
+    //
+    // A loop makes the DFS descend forever, so the nodes deeper than PATH_DEPTH
+    // on the DFS path are kept in a small hash set, like the ON_PATH nodes of
+    // HasDirectedCycle(): if a node is reached again while it is on the path
+    // the tree has a loop, and only has_loop is set. Shallow trees pay nothing
+    // for the check. Shared subtrees of a DAG are measured once per parent.
+    //
+    template<unsigned Metrics>
+    TreeMetrics Analyze(TreeNode* root, int sum=0) {
+        // Metrics that need the results of the subtrees
+        const bool need_height=(Metrics&(METRIC_HEIGHT|METRIC_BALANCE|METRIC_DIAMETER))!=0;
+        const bool need_range=(Metrics&(METRIC_MIN|METRIC_MAX|METRIC_BST))!=0;
+        const bool need_up=need_height || need_range;
+        const int PATH_DEPTH=64;    // nodes deeper than this are checked for loops
+
+        TreeMetrics m;
+        if(Metrics&METRIC_BST)
+            m.is_bst=true;  // also for an empty tree
+        if(Metrics&METRIC_BALANCE)
+            m.balanced=true;
         if(root==NULL)
-            return true;
+            return m;
 
-        assert(root->val > min && root->val < max);
+        struct Frame {
+            TreeNode* node;
+            int depth;
+            long long sum_to_now;
+            bool expanded;  // children already pushed
+        };
+        struct Up {
+            int height;
+            int min;
+            int max;
+            bool bst;
+        };
+        vector<Frame> st;
+        vector<Up> up;
+        vector<size_t> layer_nodes; // number of nodes in each layer
+        PathSet path;
+        Frame first={root,0,root->val,false};
+        st.push_back(first);
+        while(!st.empty()) {
+            Frame f=st.back();
+            TreeNode* node=f.node;
+            if(!f.expanded) {
+                if(Metrics&METRIC_SIZE)
+                    m.size++;
+                if(Metrics&METRIC_SUM)
+                    m.sum+=node->val;
+                if(Metrics&METRIC_WIDTH) {
+                    if(layer_nodes.size()<=(size_t)f.depth)
+                        layer_nodes.push_back(0);
+                    layer_nodes[f.depth]++;
+                }
+                if(node->left==NULL && node->right==NULL) {
+                    if(Metrics&METRIC_LEAVES)
+                        m.leaves++;
+                    if((Metrics&METRIC_PATH_SUM) && f.sum_to_now==sum)
+                        m.path_sums++;
+                }
 
-        bool bst_left=true;
-        bool bst_right=true;
-        if(root->left!=NULL && (root->left->val >= root->val || root->left->val <= min))
-            return false;
-        else
-            bst_left=IsBSTHelper(root->left, min, root->val);
-        
-        if(root->right!=NULL && (root->right->val <= root->val || root->right->val >= max))
-            return false;
-        else
-            bst_right=IsBSTHelper(root->right, root->val, max);
+                if(f.depth>=PATH_DEPTH && !path.Insert(node)) { // a link back to an ancestor
+                    TreeMetrics loop;
+                    loop.has_loop=true;
+                    return loop;
+                }
+                if(need_up || f.depth>=PATH_DEPTH)
+                    st.back().expanded=true;
+                else
+                    st.pop_back();  // nothing to do after the subtrees
+                TreeNode* children[2]={node->right,node->left};
+                for(auto& c:children) {
+                    if(c==NULL)
+                        continue;
+                    Frame next={c,f.depth+1,0,false};
+                    if(Metrics&METRIC_PATH_SUM)
+                        next.sum_to_now=f.sum_to_now+c->val;
+                    st.push_back(next);
+                }
+                continue;
+            }
+            st.pop_back();
+            if(f.depth>=PATH_DEPTH)
+                path.Erase(node);
+            if(!need_up)
+                continue;   // nothing to do after the subtrees
+
+            // Both subtrees are done, the right one is on top
+            Up u={1,node->val,node->val,true};
+            int hl=0, hr=0;
+            if(node->right!=NULL) {
+                Up r=up.back();
+                up.pop_back();
+                hr=r.height;
+                if(need_range) {
+                    u.bst=r.bst && r.min>node->val;
+                    u.min=min(u.min,r.min);
+                    u.max=max(u.max,r.max);
+                }
+            }
+            if(node->left!=NULL) {
+                Up l=up.back();
+                up.pop_back();
+                hl=l.height;
+                if(need_range) {
+                    u.bst=u.bst && l.bst && l.max<node->val;
+                    u.min=min(u.min,l.min);
+                    u.max=max(u.max,l.max);
+                }
+            }
+            if(need_height) {
+                u.height=1+((hl>hr) ? hl : hr);
+                if((Metrics&METRIC_BALANCE) && (hl-hr>1 || hr-hl>1))
+                    m.balanced=false;
+                if((Metrics&METRIC_DIAMETER) && hl+hr>m.diameter)
+                    m.diameter=hl+hr;
+                if((Metrics&METRIC_BALANCE) && f.depth==0)
+                    m.balance_factor=hl-hr;
+            }
+            up.push_back(u);
+        }
+
+        if(need_up) {
+            Up r=up.back();
+            if(Metrics&METRIC_HEIGHT)
+                m.height=r.height;
+            if(Metrics&METRIC_MIN)
+                m.min=r.min;
+            if(Metrics&METRIC_MAX)
+                m.max=r.max;
+            if(Metrics&METRIC_BST)
+                m.is_bst=r.bst;
+        }
+        for(auto& w:layer_nodes)
+            if(w>m.width)
+                m.width=w;
+        return m;
+    }
+
+    //
+    // Save a version of the tree and return its id. A version is just its root,
+    // so taking a snapshot is O(1).
+    //
+    int Snapshot(TreeNode* rt) {
+        versions.push_back(rt);
+        return versions.size()-1;
+    }
+
+    int Snapshot() { return Snapshot(root); }
 
-        return (bst_left && bst_right);
+    TreeNode* GetVersion(int v) { return versions[v]; }
+
+    int NumVersions() { return versions.size(); }
+
+    // Forget a saved version, its nodes are released by the next Collect().
+    // Version ids do not change, GetVersion(v) returns NULL afterwards.
+    void DropVersion(int v) { versions[v]=NULL; }
+
+    //
+    // Release the nodes that are not reachable from the root or from a saved
+    // version, such as the path copies of dropped versions and of updates whose
+    // result was never saved. Keep every root still in use as the root or a
+    // saved version. Returns the number of nodes released. Nodes in the
+    // storage of Relayout() are released with it by the next Relayout().
+    //
+    size_t Collect() {
+        TraversalWorkspace ws;
+        ws.ResetVisited();
+        vector<TreeNode*>& st=ws.stk;
+        st.clear();
+        st.push_back(root);
+        st.insert(st.end(),versions.begin(),versions.end());
+        while(!st.empty()) {
+            TreeNode* node=st.back();
+            st.pop_back();
+            if(node==NULL || !ws.Visit(node))
+                continue;
+            st.push_back(node->left);
+            st.push_back(node->right);
+        }
+
+        size_t k=0;
+        for(size_t i=0;i<all_nodes.size();++i) {
+            if(ws.State(all_nodes[i])==0)
+                FreeNode(all_nodes[i]);
+            else
+                all_nodes[k++]=all_nodes[i];
+        }
+        size_t released=all_nodes.size()-k;
+        all_nodes.resize(k);
+        if(released>0)
+            InvalidateBST();    // the addresses may be reused
+        return released;
+    }
+
+    //
+    // Persistent update: set the value of the node at the given path, where path
+    // is a string of 'L'/'R' moves from the root(e.g. "LR"). Only the nodes on the
+    // path are copied, all other nodes are shared with the old version. Returns
+    // the root of the new version, the old version rt is not changed.
+    //
+    TreeNode* SetValue(TreeNode* rt, const string& path, int val) {
+        if(rt==NULL)
+            return NULL;
+
+        // Check the path first, so that nothing is copied on error
+        TreeNode* node=rt;
+        for(auto& c:path) {
+            node=(c=='L') ? node->left : node->right;
+            if(node==NULL) {
+                cerr<<"Error: no node at path "<<path<<"!"<<endl;
+                return rt;
+            }
+        }
+
+        TreeNode* new_root=CopyNode(rt);
+        TreeNode* cur=new_root;
+        for(auto& c:path) {
+            TreeNode*& child=(c=='L') ? cur->left : cur->right;
+            child=CopyNode(child);
+            cur=child;
+        }
+        cur->val=val;
+        return new_root;
+    }
+
+    //
+    // Persistent insertion into a binary search tree. Only the nodes on the path
+    // from the root to the new leaf are copied, so on a balanced tree an update
+    // costs O(log n) time and memory. If val is already in the tree, rt itself is
+    // returned.
+    //
+    TreeNode* InsertBST(TreeNode* rt, int val) {
+        TreeNode* node=rt;
+        while(node!=NULL && node->val!=val)
+            node=(val<node->val) ? node->left : node->right;
+        if(node!=NULL)
+            return rt;  // already in the tree
+        if(rt==NULL)
+            return NewNode(val);
+
+        TreeNode* new_root=CopyNode(rt);
+        TreeNode* cur=new_root;
+        while(true) {
+            TreeNode*& child=(val<cur->val) ? cur->left : cur->right;
+            if(child==NULL) {
+                child=NewNode(val);
+                break;
+            }
+            child=CopyNode(child);
+            cur=child;
+        }
+        return new_root;
     }
 
 private:
+    // A node after hash-consing its children
+    struct NodeKey {
+        int val;
+        TreeNode* left;
+        TreeNode* right;
+
+        bool operator==(const NodeKey& k) const {
+            return val==k.val && left==k.left && right==k.right;
+        }
+    };
+
+    struct NodeKeyHash {
+        size_t operator()(const NodeKey& k) const {
+            size_t h=hash<int>()(k.val);
+            h=h*31+hash<TreeNode*>()(k.left);
+            h=h*31+hash<TreeNode*>()(k.right);
+            return h;
+        }
+    };
+
+    // Flags of BSTInfo
+    enum {
+        BST_CACHED=1,   // min, max and BST_VALID are up to date
+        BST_VALID=2,    // the subtree is a BST
+        BST_OPEN=4      // being checked: the node is on the current DFS path
+    };
+
+    // Cached result of IsBST() for a subtree, 32 bytes
+    struct BSTInfo {
+        TreeNode* node;     // NULL for a free slot
+        TreeNode* parent;   // parent seen by IsBST(), used by MarkDirty()
+        int min;    // minimum value in the subtree
+        int max;    // maximum value in the subtree
+        unsigned char flags;
+    };
+
+    //
+    // The IsBST() cache is an open addressing table of BSTInfo(linear probing,
+    // at most 3/4 full), about 40 to 85 bytes per node instead of two node-based
+    // hash maps. Entries are never removed one by one: MarkDirty() only clears
+    // BST_CACHED.
+    //
+    struct BSTCache {
+        vector<BSTInfo> table;
+        size_t used;    // number of entries in table
+
+        BSTCache() : used(0) {}
+
+        void Swap(BSTCache& o) {
+            table.swap(o.table);
+            swap(used,o.used);
+        }
+    };
+
+    BSTInfo* FindBST(BSTCache& c, TreeNode* node) {
+        if(node==NULL || c.table.empty())
+            return NULL;
+        size_t mask=c.table.size()-1;
+        for(size_t h=HashNode(node)&mask;c.table[h].node!=NULL;h=(h+1)&mask)
+            if(c.table[h].node==node)
+                return &c.table[h];
+        return NULL;
+    }
+
+    // The entry of node, added if it is not there. Invalidates other entries.
+    BSTInfo& AddBST(BSTCache& c, TreeNode* node) {
+        if(4*(c.used+1)>3*c.table.size()) {
+            vector<BSTInfo> old;
+            old.swap(c.table);
+            BSTInfo empty={NULL,NULL,0,0,0};
+            c.table.assign(max((size_t)16,2*old.size()),empty);
+            for(auto& e:old)
+                if(e.node!=NULL)
+                    *Probe(c,e.node)=e;
+        }
+        BSTInfo* e=Probe(c,node);
+        if(e->node==NULL) {
+            e->node=node;
+            c.used++;
+        }
+        return *e;
+    }
+
+    // The slot holding node, or the free slot where it would be added
+    BSTInfo* Probe(BSTCache& c, TreeNode* node) {
+        size_t mask=c.table.size()-1;
+        size_t h=HashNode(node)&mask;
+        while(c.table[h].node!=NULL && c.table[h].node!=node)
+            h=(h+1)&mask;
+        return &c.table[h];
+    }
+
+    //
+    // IsBST() with the given cache
+    //
+    bool CheckBST(TreeNode* root, BSTCache& cache) {
+        vector<pair<TreeNode*,bool> > st; // <node, children already pushed>
+        st.push_back(make_pair(root,false));
+        bool valid=true;
+        while(!st.empty()) {
+            TreeNode* node=st.back().first;
+            if(!st.back().second) {
+                BSTInfo* e=FindBST(cache,node);
+                if(e!=NULL && (e->flags&BST_CACHED)) { // clean subtree
+                    st.pop_back();
+                    continue;
+                }
+                AddBST(cache,node).flags|=BST_OPEN;
+                st.back().second=true;
+                TreeNode* children[2]={node->right,node->left};
+                for(auto& c:children) {
+                    if(c==NULL)
+                        continue;
+                    BSTInfo& ce=AddBST(cache,c);
+                    if(ce.flags&BST_OPEN) {
+                        valid=false;    // link back to an ancestor: a loop
+                        break;
+                    }
+                    ce.parent=node;
+                    st.push_back(make_pair(c,false));
+                }
+                if(!valid)
+                    break;
+                continue;
+            }
+            st.pop_back();
+
+            // Both subtrees have been checked, combine them with the root
+            int mn=node->val, mx=node->val;
+            if(node->left!=NULL) {
+                BSTInfo* l=FindBST(cache,node->left);
+                valid=(l->flags&BST_VALID) && l->max<node->val;
+                mn=l->min;
+            }
+            if(node->right!=NULL) {
+                BSTInfo* r=FindBST(cache,node->right);
+                valid=valid && (r->flags&BST_VALID) && r->min>node->val;
+                mx=r->max;
+            }
+            BSTInfo* e=FindBST(cache,node);
+            e->min=mn;
+            e->max=mx;
+            e->flags=BST_CACHED|(valid ? BST_VALID : 0);
+            if(!valid)
+                break;
+        }
+
+        // Nodes left on the stack are not checked
+        for(auto& item:st) {
+            BSTInfo* e=FindBST(cache,item.first);
+            if(e!=NULL)
+                e->flags&=~BST_OPEN;
+        }
+        return valid && (FindBST(cache,root)->flags&BST_VALID);
+    }
+
+    //
+    // Set of the nodes on a DFS path, used by Analyze(). Unlike the visited set
+    // of TraversalWorkspace nodes are removed again(linear probing with
+    // backward shift), so the table stays as small as the path and in cache.
+    //
+    struct PathSet {
+        vector<TreeNode*> slots;
+        size_t used;
+
+        PathSet() : used(0) {}
+
+        // Return false if node is already in the set
+        bool Insert(TreeNode* node) {
+            if(2*(used+1)>slots.size()) {
+                vector<TreeNode*> old(max((size_t)16,2*slots.size()),(TreeNode*)NULL);
+                old.swap(slots);
+                for(auto& n:old)
+                    if(n!=NULL)
+                        *Slot(n)=n;
+            }
+            TreeNode** h=Slot(node);
+            if(*h==node)
+                return false;
+            *h=node;
+            used++;
+            return true;
+        }
+
+        // node must be in the set
+        void Erase(TreeNode* node) {
+            size_t mask=slots.size()-1;
+            size_t i=HashNode(node)&mask;
+            while(slots[i]!=node)
+                i=(i+1)&mask;
+            // Move back the following entries that can no longer be reached
+            for(size_t j=(i+1)&mask;slots[j]!=NULL;j=(j+1)&mask) {
+                size_t home=HashNode(slots[j])&mask;
+                bool reachable=(i<j) ? (i<home && home<=j) : (i<home || home<=j);
+                if(!reachable) {
+                    slots[i]=slots[j];
+                    i=j;
+                }
+            }
+            slots[i]=NULL;
+            used--;
+        }
+
+        // The slot holding node, or the free slot where it would be inserted
+        TreeNode** Slot(TreeNode* node) {
+            size_t mask=slots.size()-1;
+            size_t h=HashNode(node)&mask;
+            while(slots[h]!=NULL && slots[h]!=node)
+                h=(h+1)&mask;
+            return &slots[h];
+        }
+    };
+
+    // The node with the given value in the sorted <val,index> pairs of
+    // BuildCycleTree(), or NULL
+    TreeNode* FindByVal(TraversalWorkspace& ws, int val) {
+        vector<pair<int,size_t> >::iterator it=upper_bound(ws.vals.begin(),ws.vals.end(),make_pair(val,(size_t)-1));
+        if(it==ws.vals.begin() || (it-1)->first!=val)
+            return NULL;
+        return ws.q[(it-1)->second];
+    }
+
+    // States of the nodes in the workspace of Relayout()
+    enum {
+        RELAYOUT_OWNED=1,   // in all_nodes
+        RELAYOUT_SEEN=2     // in all_nodes, counted by VebHeight()
+    };
+
+    // Node is in the storage of the last Relayout(), so it is not deleted one by one
+    bool InArena(TreeNode* node) {
+        return !arena.empty() && !less<TreeNode*>()(node,&arena[0])
+            && less<TreeNode*>()(node,&arena[0]+arena.size());
+    }
+
+    void FreeNode(TreeNode* node) {
+        if(!InArena(node))
+            delete node;
+    }
+
+    // Relayout(): node has been copied to fresh(its left is the forwarding pointer)
+    static bool Moved(TreeNode* node, vector<TreeNode>& fresh) {
+        TreeNode* fwd=node->left;
+        return fwd!=NULL && !fresh.empty() && !less<TreeNode*>()(fwd,&fresh[0])
+            && less<TreeNode*>()(fwd,&fresh[0]+fresh.capacity());
+    }
+
+    // Relayout(): node is owned by this tree and not moved yet
+    static bool Movable(TreeNode* node, TraversalWorkspace& owned, vector<TreeNode>& fresh) {
+        return node!=NULL && owned.State(node)!=0 && !Moved(node,fresh);
+    }
+
+    // Relayout(): copy node to the end of fresh and leave a forwarding pointer
+    static TreeNode* MoveTo(TreeNode* node, vector<TreeNode>& fresh) {
+        fresh.push_back(*node);
+        node->left=&fresh.back();
+        return &fresh.back();
+    }
+
+    //
+    // Relayout(): number of layers of the nodes below node that are not moved
+    // yet. Each node is counted once, at the depth it is first reached, so for
+    // a DAG this may be less than the longest path; nodes the vEB placement
+    // does not reach are then placed later on their own.
+    //
+    static size_t VebHeight(TreeNode* node, TraversalWorkspace& owned, vector<TreeNode>& fresh,
+            vector<pair<TreeNode*,size_t> >& st) {
+        size_t h=0;
+        st.clear();
+        st.push_back(make_pair(node,(size_t)1));
+        while(!st.empty()) {
+            TreeNode* cur=st.back().first;
+            size_t d=st.back().second;
+            st.pop_back();
+            if(!Movable(cur,owned,fresh) || owned.State(cur)==RELAYOUT_SEEN)
+                continue;
+            owned.SetState(cur,RELAYOUT_SEEN);
+            h=max(h,d);
+            st.push_back(make_pair(cur->right,d+1));
+            st.push_back(make_pair(cur->left,d+1));
+        }
+        return h;
+    }
+
+    //
+    // Relayout(): move the h layers below node v in van Emde Boas order. The
+    // top h/2 layers are placed first, recursively. Their copies are then
+    // fresh[first..last), and the children of these copies that are not moved
+    // yet are the roots of the bottom subtrees, from left to right. The depth
+    // of the recursion is O(log h).
+    //
+    static void VebPlace(TreeNode* v, size_t h, TraversalWorkspace& owned, vector<TreeNode>& fresh) {
+        if(h<=1) {
+            MoveTo(v,fresh);
+            return;
+        }
+        size_t top=h/2;
+        size_t first=fresh.size();
+        VebPlace(v,top,owned,fresh);
+        size_t last=fresh.size();
+        for(size_t i=first;i<last;++i) {
+            TreeNode* children[2]={fresh[i].left,fresh[i].right};
+            for(auto& c:children)
+                if(Movable(c,owned,fresh))
+                    VebPlace(c,h-top,owned,fresh);
+        }
+    }
+
+    // Allocate a node owned by this tree
+    TreeNode* NewNode(int val) {
+        TreeNode* node=new TreeNode(val);
+        all_nodes.push_back(node);
+        return node;
+    }
+
+    // Copy a node, the copy shares both subtrees with the original
+    TreeNode* CopyNode(TreeNode* node) {
+        TreeNode* copy=NewNode(node->val);
+        copy->left=node->left;
+        copy->right=node->right;
+        return copy;
+    }
+
     TreeNode* root;
+    vector<TreeNode*> versions; // roots of the saved versions
     vector<TreeNode*> all_nodes; // record all tree nodes, used for releasing memory
+    vector<TreeNode> arena; // contiguous node storage made by Relayout()
     int layers; // number of layers
+    size_t trace_len; // number of nodes of the root, shared nodes counted once per parent
+    bool shared_subtrees; // set by CompactDAG(): nodes may have several parents
+    BSTCache bst; // per-subtree results of IsBST() for the root and the saved versions
 };
 
 #endif // _BINARYTREE_H_
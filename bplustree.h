@@ -0,0 +1,406 @@
+#ifndef _BPLUSTREE_H_
+#define _BPLUSTREE_H_
+
+////////////////////////////////////////////////////////////////
+//
+// Multiway(B+ tree) node engine for ordered lookups.
+//
+// A lookup in a binary search tree of TreeNodes compares one key per node,
+// and each node is usually a cache miss. BPlusTree packs many keys into nodes
+// of NodeBytes bytes(a multiple of the 64-byte cache line), so a lookup only
+// touches about log(n)/log(fanout) nodes:
+//
+//  1. Inner nodes hold up to K=(NodeBytes-8)/8 keys and K+1 children, leaves
+//  hold up to L=(NodeBytes-8)/4 keys. With NodeBytes=256 that is 31 keys and
+//  32 children per inner node and 62 keys per leaf, and a tree of 10^8 keys is
+//  6 levels deep instead of at least 27.
+//
+//  2. Children are 32-bit indexes into two pools(one for inner nodes and one
+//  for leaves) aligned to the cache line, instead of 64-bit pointers.
+//
+//  3. Key i of an inner node is the largest key in child i. Unused key slots
+//  are INT_MAX, so the position of x in a node is the number of keys smaller
+//  than x, which is counted with SSE2 4 keys at a time and without branches.
+//
+//  4. Leaves are linked in key order, so the sorted iteration(the same as
+//  InorderTraversal() of a BST) is a scan of the leaves.
+//
+// Keys are unique, like the nodes of a BST. Example:
+//  BPlusTree<> bp;
+//  bp.BulkLoad(bt.InorderTraversal(root)); // from a BST
+//  bp.Insert(12);
+//  bp.Contains(5);
+//
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <new>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "binarytree.h"
+
+using namespace std;
+
+template<int NodeBytes=256>
+class BPlusTree {
+public:
+    static const int K=(NodeBytes-8)/8;  // keys per inner node
+    static const int L=(NodeBytes-8)/4;  // keys per leaf
+
+    BPlusTree() : root(0), height(0), nkeys(0), first_leaf(0), last_leaf(0) {}
+
+    // Number of keys
+    size_t Size() { return nkeys; }
+
+    // Number of levels, leaves included
+    int Height() { return height; }
+
+    size_t MemoryBytes() { return inners.MemoryBytes()+leaves.MemoryBytes(); }
+
+    //
+    // Insert a key. Return false if the key is already in the tree.
+    //
+    bool Insert(int x) {
+        if(height==0) {
+            root=first_leaf=last_leaf=leaves.New();
+            height=1;
+        }
+
+        // Descend to the leaf, remembering the path
+        uint32_t path[MAX_HEIGHT];
+        int pos[MAX_HEIGHT];
+        uint32_t idx=root;
+        for(int h=0;h<height-1;++h) {
+            Inner& in=inners[idx];
+            path[h]=idx;
+            pos[h]=CountLess<K>(in.keys,x);
+            idx=in.children[pos[h]];
+        }
+
+        Leaf* lf=&leaves[idx];
+        int p=CountLess<L>(lf->keys,x);
+        if(p<(int)lf->count && lf->keys[p]==x)
+            return false;
+        nkeys++;
+        if((int)lf->count<L) {
+            InsertAt(lf->keys,lf->count,p,x);
+            lf->count++;
+            return true;
+        }
+
+        // Split the leaf: the upper half moves to a new leaf
+        uint32_t nidx=leaves.New();
+        lf=&leaves[idx];    // the pool may have moved
+        Leaf& nl=leaves[nidx];
+        int tmp[L+1];
+        memcpy(tmp,lf->keys,sizeof(lf->keys));
+        InsertAt(tmp,L,p,x);
+        int half=(L+1)/2;
+        FillLeaf(*lf,tmp,half);
+        FillLeaf(nl,tmp+half,L+1-half);
+        nl.next=lf->next;
+        lf->next=nidx;
+        if(last_leaf==idx)
+            last_leaf=nidx;
+
+        // Insert the separator into the parents, splitting them as needed
+        int sep=lf->keys[half-1];
+        uint32_t right=nidx;
+        for(int h=height-2;h>=0;--h) {
+            Inner* in=&inners[path[h]];
+            if((int)in->count<K) {
+                InsertAt(in->keys,in->count,pos[h],sep);
+                InsertAt(in->children,in->count+1,pos[h]+1,right);
+                in->count++;
+                return true;
+            }
+
+            uint32_t sidx=inners.New();
+            in=&inners[path[h]];
+            Inner& sib=inners[sidx];
+            int tk[K+1];
+            uint32_t tc[K+2];
+            memcpy(tk,in->keys,sizeof(in->keys));
+            memcpy(tc,in->children,sizeof(in->children));
+            InsertAt(tk,K,pos[h],sep);
+            InsertAt(tc,K+1,pos[h]+1,right);
+            // Left keeps m children, key m-1 moves up
+            int m=(K+2)/2;
+            FillInner(*in,tk,tc,m-1);
+            FillInner(sib,tk+m,tc+m,K+1-m);
+            sep=tk[m-1];
+            right=sidx;
+        }
+
+        // The root was split
+        uint32_t ridx=inners.New();
+        Inner& rt=inners[ridx];
+        int rk[1]={sep};
+        uint32_t rc[2]={root,right};
+        FillInner(rt,rk,rc,1);
+        root=ridx;
+        height++;
+        return true;
+    }
+
+    bool Contains(int x) {
+        int k;
+        return LowerBound(x,k) && k==x;
+    }
+
+    //
+    // Find the smallest key not less than x. Return false if there is none.
+    //
+    bool LowerBound(int x, int& key) {
+        if(height==0)
+            return false;
+        uint32_t idx=root;
+        for(int h=0;h<height-1;++h) {
+            Inner& in=inners[idx];
+            idx=in.children[CountLess<K>(in.keys,x)];
+        }
+        Leaf& lf=leaves[idx];
+        int p=CountLess<L>(lf.keys,x);
+        if(p==(int)lf.count) {
+            // All keys of this leaf are smaller, so x is larger than the
+            // largest key of the subtree and the answer is in the next leaf
+            if(lf.next==NIL)
+                return false;
+            key=leaves[lf.next].keys[0];
+            return true;
+        }
+        key=lf.keys[p];
+        return true;
+    }
+
+    // The smallest key, the tree must not be empty
+    int Min() {
+        assert(nkeys>0);
+        return leaves[first_leaf].keys[0];
+    }
+
+    // The largest key, the tree must not be empty
+    int Max() {
+        assert(nkeys>0);
+        Leaf& lf=leaves[last_leaf];
+        return lf.keys[lf.count-1];
+    }
+
+    //
+    // Build the tree from keys sorted in ascending order, such as the inorder
+    // traversal of a BST. Duplicated keys are ignored. The nodes of each level
+    // are filled evenly and allocated in key order, so a scan of the leaves
+    // reads consecutive memory.
+    //
+    void BulkLoad(const vector<int>& keys) {
+        inners.Clear();
+        leaves.Clear();
+        height=0;
+        nkeys=0;
+        vector<int> uniq;
+        uniq.reserve(keys.size());
+        for(auto& k:keys)
+            if(uniq.empty() || uniq.back()!=k)
+                uniq.push_back(k);
+        if(uniq.empty())
+            return;
+
+        // Leaves
+        vector<uint32_t> level;   // nodes of the current level
+        vector<int> maxes;          // largest key under each node
+        size_t n=uniq.size();
+        size_t cnt=(n+L-1)/L;
+        size_t done=0;
+        for(size_t i=0;i<cnt;++i) {
+            size_t take=n/cnt+(i<n%cnt ? 1 : 0);
+            uint32_t idx=leaves.New();
+            FillLeaf(leaves[idx],&uniq[done],take);
+            if(!level.empty())
+                leaves[level.back()].next=idx;
+            level.push_back(idx);
+            done+=take;
+            maxes.push_back(uniq[done-1]);
+        }
+        first_leaf=level.front();
+        last_leaf=level.back();
+        nkeys=n;
+        height=1;
+
+        // Inner levels, until a single root is left
+        while(level.size()>1) {
+            vector<uint32_t> up;
+            vector<int> upmaxes;
+            n=level.size();
+            cnt=(n+K)/(K+1);
+            done=0;
+            for(size_t i=0;i<cnt;++i) {
+                size_t take=n/cnt+(i<n%cnt ? 1 : 0);
+                uint32_t idx=inners.New();
+                FillInner(inners[idx],&maxes[done],&level[done],take-1);
+                up.push_back(idx);
+                done+=take;
+                upmaxes.push_back(maxes[done-1]);
+            }
+            level.swap(up);
+            maxes.swap(upmaxes);
+            height++;
+        }
+        root=level[0];
+    }
+
+    //
+    // All keys in ascending order, the same as InorderTraversal() of a BST
+    // holding the keys.
+    //
+    vector<int> InorderTraversal() {
+        vector<int> trace;
+        trace.reserve(nkeys);
+        InorderTraversal(back_inserter(trace));
+        return trace;
+    }
+
+    template<typename OutputIt>
+    OutputIt InorderTraversal(OutputIt out) {
+        if(height==0)
+            return out;
+        for(uint32_t idx=first_leaf;idx!=NIL;idx=leaves[idx].next) {
+            Leaf& lf=leaves[idx];
+            for(uint32_t i=0;i<lf.count;++i)
+                *out++=lf.keys[i];
+        }
+        return out;
+    }
+
+private:
+    static const uint32_t NIL=0xFFFFFFFF;
+    static const int MAX_HEIGHT=32;
+    static const size_t CACHE_LINE=64;
+
+    struct Inner {
+        int keys[K];            // key i is the largest key under child i
+        uint32_t children[K+1];
+        uint32_t count;         // number of keys, count+1 children are used
+    };
+
+    struct Leaf {
+        int keys[L];
+        uint32_t count;
+        uint32_t next;          // next leaf in key order
+    };
+
+    static_assert(NodeBytes>=32 && NodeBytes%8==0, "NodeBytes must be a multiple of 8, at least 32");
+    static_assert(sizeof(Inner)==NodeBytes && sizeof(Leaf)==NodeBytes, "unexpected node padding");
+
+    //
+    // Nodes of one kind in cache-line-aligned memory, addressed by 32-bit
+    // index. New nodes are filled with INT_MAX keys and NIL links.
+    //
+    template<typename Node>
+    class Pool {
+    public:
+        Pool() : raw(NULL), nodes(NULL), n(0), cap(0) {}
+        ~Pool() { free(raw); }
+
+        Node& operator[](uint32_t i) { return nodes[i]; }
+
+        uint32_t New() {
+            if(n==cap)
+                Grow();
+            memset(&nodes[n],0xFF,sizeof(Node));    // NIL links
+            for(auto& k:nodes[n].keys)
+                k=INT_MAX;
+            nodes[n].count=0;
+            return (uint32_t)n++;
+        }
+
+        void Clear() { n=0; }
+
+        size_t MemoryBytes() { return cap*sizeof(Node); }
+
+    private:
+        Pool(const Pool&);
+        Pool& operator=(const Pool&);
+
+        void Grow() {
+            size_t ncap=(cap==0) ? 16 : cap*2;
+            char* nraw=(char*)malloc(ncap*sizeof(Node)+CACHE_LINE);
+            if(nraw==NULL)
+                throw bad_alloc();
+            Node* nnodes=(Node*)(((uintptr_t)nraw+CACHE_LINE-1)&~(uintptr_t)(CACHE_LINE-1));
+            if(n>0)
+                memcpy(nnodes,nodes,n*sizeof(Node));
+            free(raw);
+            raw=nraw;
+            nodes=nnodes;
+            cap=ncap;
+        }
+
+        char* raw;      // allocated memory
+        Node* nodes;    // first cache line boundary in raw
+        size_t n;
+        size_t cap;
+    };
+
+    //
+    // Number of keys smaller than x. Unused slots are INT_MAX and never
+    // counted, so all N slots are compared without looking at the count.
+    //
+    template<int N>
+    static int CountLess(const int* keys, int x) {
+        int c=0, i=0;
+#if defined(__SSE2__)
+        __m128i vx=_mm_set1_epi32(x);
+        __m128i acc=_mm_setzero_si128();
+        for(;i+4<=N;i+=4) {
+            __m128i k=_mm_loadu_si128((const __m128i*)(keys+i));
+            acc=_mm_sub_epi32(acc,_mm_cmplt_epi32(k,vx));   // true is -1
+        }
+        acc=_mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,0,3,2)));
+        acc=_mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(2,3,0,1)));
+        c=_mm_cvtsi128_si32(acc);
+#endif
+        for(;i<N;++i)
+            c+=(keys[i]<x);
+        return c;
+    }
+
+    // Insert v at position p of the first n elements of a
+    template<typename T>
+    static void InsertAt(T* a, int n, int p, T v) {
+        memmove(a+p+1,a+p,(n-p)*sizeof(T));
+        a[p]=v;
+    }
+
+    static void FillLeaf(Leaf& lf, const int* keys, size_t n) {
+        for(int i=0;i<L;++i)
+            lf.keys[i]=(i<(int)n) ? keys[i] : INT_MAX;
+        lf.count=n;
+    }
+
+    // An inner node with n keys and n+1 children
+    static void FillInner(Inner& in, const int* keys, const uint32_t* children, size_t n) {
+        for(int i=0;i<K;++i)
+            in.keys[i]=(i<(int)n) ? keys[i] : INT_MAX;
+        for(int i=0;i<=K;++i) {
+            if(i<=(int)n)
+                in.children[i]=children[i];
+            else
+                in.children[i]=NIL;
+        }
+        in.count=n;
+    }
+
+    Pool<Inner> inners;
+    Pool<Leaf> leaves;
+    uint32_t root;
+    int height;         // 0 for an empty tree, 1 if the root is a leaf
+    size_t nkeys;
+    uint32_t first_leaf;
+    uint32_t last_leaf;
+};
+
+#endif // _BPLUSTREE_H_
@@ -0,0 +1,228 @@
+#ifndef _INTERLEAVE_H_
+#define _INTERLEAVE_H_
+
+////////////////////////////////////////////////////////////////
+//
+// Interleaved execution of many independent tree walks.
+//
+// Walking a large tree of TreeNodes stalls on a cache miss at almost every
+// level, and a single walk has only one miss in flight. InterleavedWalker
+// runs a group of independent walks(lanes) in round-robin, in the style of
+// asynchronous memory access chaining(AMAC): each lane is an explicit state
+// machine that does one step, prefetches the node it needs next and yields
+// to the next lane. By the time a lane runs again its node is usually in
+// cache, so the core keeps up to width misses in flight instead of one.
+// When a walk is finished its lane starts the next query.
+//
+// Supported walks:
+//  1. Lookup(): point lookups in a binary search tree.
+//  2. HasPathSum(): does a root-to-leaf path with the given sum exist, for
+//  many (root, sum) queries.
+//  3. IsSameTree(): pairwise comparison of many tree pairs.
+//
+// The results are the same as running the queries one after another. The
+// width(number of lanes) should be a bit more than the number of misses the
+// core can keep in flight, 8 to 32 is typical.
+//
+////////////////////////////////////////////////////////////////
+
+#include "binarytree.h"
+
+using namespace std;
+
+#if defined(__GNUC__)
+#define TREE_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define TREE_PREFETCH(p)
+#endif
+
+class InterleavedWalker {
+public:
+    InterleavedWalker(int w=16) : width(w>0 ? w : 1) {}
+
+    //
+    // Look up each key in the binary search tree rooted at root. found[i] is
+    // the node holding keys[i], or NULL.
+    //
+    void Lookup(TreeNode* root, const vector<int>& keys, vector<TreeNode*>& found) {
+        found.assign(keys.size(),NULL);
+        struct Lane {
+            size_t query;
+            TreeNode* node;
+        };
+        vector<Lane> lanes;
+        size_t next=0;
+        for(;next<keys.size() && (int)lanes.size()<width;++next) {
+            Lane l={next,root};
+            lanes.push_back(l);
+        }
+        TREE_PREFETCH(root);
+
+        while(!lanes.empty()) {
+            for(size_t i=0;i<lanes.size();) {
+                Lane& l=lanes[i];
+                TreeNode* node=l.node;
+                int key=keys[l.query];
+                if(node!=NULL && node->val!=key) {   // one level down
+                    l.node=(key<node->val) ? node->left : node->right;
+                    TREE_PREFETCH(l.node);
+                    ++i;
+                    continue;
+                }
+                found[l.query]=node;
+                if(!Refill(lanes,i,next,keys.size())) // lane i now holds another query
+                    continue;
+                lanes[i].node=root;
+                ++i;
+            }
+        }
+    }
+
+    //
+    // For each i, check if the tree rooted at roots[i] has a root-to-leaf path
+    // whose sum equals sums[i].
+    //
+    void HasPathSum(const vector<TreeNode*>& roots, const vector<int>& sums, vector<char>& result) {
+        result.assign(roots.size(),0);
+        struct Lane {
+            size_t query;
+            vector<pair<TreeNode*,int> > st;  // DFS stack of <node, sum to now>
+        };
+        vector<Lane> lanes(min((size_t)width,roots.size()));
+        size_t next=0;
+        size_t active=0;
+        for(size_t i=0;i<lanes.size();++i) {
+            while(next<roots.size() && lanes[i].st.empty())
+                StartPathSum(lanes[i].st,lanes[i].query,next++,roots);
+            if(!lanes[i].st.empty())
+                active++;
+        }
+
+        while(active>0) {
+            for(size_t i=0;i<lanes.size();++i) {
+                Lane& l=lanes[i];
+                if(l.st.empty())
+                    continue;
+                TreeNode* node=l.st.back().first;
+                int s=l.st.back().second+node->val;
+                l.st.pop_back();
+                bool done=false;
+                if(node->left==NULL && node->right==NULL) {
+                    if(s==sums[l.query]) {
+                        result[l.query]=1;
+                        done=true;
+                    }
+                } else {
+                    if(node->right!=NULL)
+                        l.st.push_back(make_pair(node->right,s));
+                    if(node->left!=NULL)
+                        l.st.push_back(make_pair(node->left,s));
+                }
+                if(!done && !l.st.empty()) {
+                    TREE_PREFETCH(l.st.back().first);
+                    continue;
+                }
+                // Query finished, start the next one
+                l.st.clear();
+                while(next<roots.size() && l.st.empty())
+                    StartPathSum(l.st,l.query,next++,roots);
+                if(l.st.empty())
+                    active--;
+            }
+        }
+    }
+
+    //
+    // For each i, check if p[i] and q[i] are structurally identical with the
+    // same values.
+    //
+    void IsSameTree(const vector<TreeNode*>& p, const vector<TreeNode*>& q, vector<char>& result) {
+        result.assign(p.size(),1);
+        struct Lane {
+            size_t query;
+            vector<pair<TreeNode*,TreeNode*> > st;
+        };
+        vector<Lane> lanes(min((size_t)width,p.size()));
+        size_t next=0;
+        size_t active=0;
+        for(size_t i=0;i<lanes.size();++i) {
+            while(next<p.size() && lanes[i].st.empty())
+                StartSameTree(lanes[i].st,lanes[i].query,next++,p,q,result);
+            if(!lanes[i].st.empty())
+                active++;
+        }
+
+        while(active>0) {
+            for(size_t i=0;i<lanes.size();++i) {
+                Lane& l=lanes[i];
+                if(l.st.empty())
+                    continue;
+                TreeNode* tp=l.st.back().first;
+                TreeNode* tq=l.st.back().second;
+                l.st.pop_back();
+                bool same=(tp->val==tq->val) && (tp->left==NULL)==(tq->left==NULL)
+                    && (tp->right==NULL)==(tq->right==NULL);
+                if(same) {
+                    if(tp->right!=NULL)
+                        l.st.push_back(make_pair(tp->right,tq->right));
+                    if(tp->left!=NULL)
+                        l.st.push_back(make_pair(tp->left,tq->left));
+                    if(!l.st.empty()) {
+                        TREE_PREFETCH(l.st.back().first);
+                        TREE_PREFETCH(l.st.back().second);
+                        continue;
+                    }
+                } else {
+                    result[l.query]=0;
+                }
+                // Query finished, start the next one
+                l.st.clear();
+                while(next<p.size() && l.st.empty())
+                    StartSameTree(l.st,l.query,next++,p,q,result);
+                if(l.st.empty())
+                    active--;
+            }
+        }
+    }
+
+private:
+    //
+    // Give lane i of a lookup the next query. If there is none, the lane is
+    // removed(the last lane is moved into slot i) and false is returned.
+    //
+    template<typename Lane>
+    static bool Refill(vector<Lane>& lanes, size_t i, size_t& next, size_t n) {
+        if(next<n) {
+            lanes[i].query=next++;
+            return true;
+        }
+        lanes[i]=lanes.back();
+        lanes.pop_back();
+        return false;
+    }
+
+    static void StartPathSum(vector<pair<TreeNode*,int> >& st, size_t& query, size_t i,
+            const vector<TreeNode*>& roots) {
+        query=i;
+        if(roots[i]!=NULL) {    // an empty tree has no path
+            st.push_back(make_pair(roots[i],0));
+            TREE_PREFETCH(roots[i]);
+        }
+    }
+
+    static void StartSameTree(vector<pair<TreeNode*,TreeNode*> >& st, size_t& query, size_t i,
+            const vector<TreeNode*>& p, const vector<TreeNode*>& q, vector<char>& result) {
+        query=i;
+        if(p[i]==NULL || q[i]==NULL) {
+            result[i]=(p[i]==q[i]);
+            return;
+        }
+        st.push_back(make_pair(p[i],q[i]));
+        TREE_PREFETCH(p[i]);
+        TREE_PREFETCH(q[i]);
+    }
+
+    int width;  // number of lanes
+};
+
+#endif // _INTERLEAVE_H_
@@ -0,0 +1,487 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+////////////////////////////////////////////////////////////////
+//
+// Streaming ingest pipeline for binary trees.
+//
+// Tree definitions arrive as a stream of records, one tree per line in the
+// level-order representation used by BinaryTree::BuildTree(), e.g.
+//  {1,2,3,#,#,4,#,#,5}
+// (braces and spaces are optional). TreePipeline runs the work in stages,
+// each on its own threads, so reading, parsing, building and analyzing
+// overlap:
+//
+//  read(calling thread) -> parse -> build -> analyze
+//
+// 1. Read: lines are read from the input stream and grouped into batches.
+// 2. Parse: each line is split into tokens, and the tokens are checked.
+// 3. Build: a BinaryTree is built from the tokens of each record.
+// 4. Analyze: a user function is called with the record number and the
+// BinaryTree, and can call any BinaryTree method. It is called from several
+// threads at once if there is more than one analysis thread. Records that
+// cannot be parsed are reported to cerr and analyzed as empty trees.
+//
+// Stages are connected by bounded lock-free queues of batches. When a queue is
+// full the upstream stage waits(backpressure), so the memory in flight is
+// limited to about queue_capacity*batch_size records per queue. A waiting
+// thread spins for a few rounds and then blocks, so stages waiting on I/O do
+// not keep a core busy. The number of
+// threads of each stage, the batch size and the queue capacity can be set by
+// PipelineConfig.
+//
+// Each stage keeps counters of items, batches, busy time, time blocked on a
+// full output queue, time idle on an empty input queue and latency(time from
+// reading a batch to finishing it in this stage), see StageStats.
+//
+// Build with -pthread.
+//
+////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <climits>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <istream>
+#include <stdexcept>
+#include "binarytree.h"
+
+using namespace std;
+
+//
+// Bounded multi-producer multi-consumer lock-free queue(Dmitry Vyukov's
+// algorithm). Each cell has a sequence number telling whether it is ready to
+// be written or read for the current lap, so producers and consumers only
+// contend on their own position counter. The capacity is rounded up to a
+// power of two.
+//
+// Threads that have to wait can Sleep() until the queue is not empty or not
+// full. Push and pop only take the lock when a thread is sleeping.
+//
+template<typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity) {
+        size_t cap=2;
+        while(cap<capacity)
+            cap<<=1;
+        mask=cap-1;
+        cells.reset(new Cell[cap]);
+        for(size_t i=0;i<cap;++i)
+            cells[i].seq.store(i,memory_order_relaxed);
+        head.store(0,memory_order_relaxed);
+        tail.store(0,memory_order_relaxed);
+        closed.store(false,memory_order_relaxed);
+        sleepers.store(0,memory_order_relaxed);
+        epoch.store(0,memory_order_relaxed);
+    }
+
+    // Return false if the queue is full
+    bool TryPush(const T& v) {
+        Cell* c;
+        size_t pos=tail.load(memory_order_relaxed);
+        while(true) {
+            c=&cells[pos&mask];
+            size_t seq=c->seq.load(memory_order_acquire);
+            intptr_t dif=(intptr_t)seq-(intptr_t)pos;
+            if(dif==0) {
+                if(tail.compare_exchange_weak(pos,pos+1,memory_order_relaxed))
+                    break;
+            } else if(dif<0) {
+                return false;
+            } else {
+                pos=tail.load(memory_order_relaxed);
+            }
+        }
+        c->data=v;
+        c->seq.store(pos+1,memory_order_release);
+        Wake();
+        return true;
+    }
+
+    // Return false if the queue is empty
+    bool TryPop(T& v) {
+        Cell* c;
+        size_t pos=head.load(memory_order_relaxed);
+        while(true) {
+            c=&cells[pos&mask];
+            size_t seq=c->seq.load(memory_order_acquire);
+            intptr_t dif=(intptr_t)seq-(intptr_t)(pos+1);
+            if(dif==0) {
+                if(head.compare_exchange_weak(pos,pos+1,memory_order_relaxed))
+                    break;
+            } else if(dif<0) {
+                return false;
+            } else {
+                pos=head.load(memory_order_relaxed);
+            }
+        }
+        v=c->data;
+        c->seq.store(pos+mask+1,memory_order_release);
+        Wake();
+        return true;
+    }
+
+    // Called after the last push: consumers stop once the queue is drained
+    void Close() {
+        closed.store(true,memory_order_release);
+        Wake();
+    }
+
+    bool Closed() { return closed.load(memory_order_acquire); }
+
+    // No item to pop. A hint only, other threads may push or pop at any time.
+    bool Empty() {
+        size_t pos=head.load(memory_order_relaxed);
+        size_t seq=cells[pos&mask].seq.load(memory_order_acquire);
+        return (intptr_t)seq-(intptr_t)(pos+1)<0;
+    }
+
+    // No free cell to push. A hint only, like Empty().
+    bool Full() {
+        size_t pos=tail.load(memory_order_relaxed);
+        size_t seq=cells[pos&mask].seq.load(memory_order_acquire);
+        return (intptr_t)seq-(intptr_t)pos<0;
+    }
+
+    //
+    // Block until ready() is true, e.g. !Full() or !Empty() || Closed().
+    // ready() is checked once more after the thread counts itself as a sleeper,
+    // and every push, pop and Close() bumps the epoch before it looks for
+    // sleepers, so a change that ready() missed always wakes the thread.
+    //
+    template<typename Pred>
+    void Sleep(Pred ready) {
+        sleepers++;
+        size_t e=epoch.load();
+        if(!ready()) {
+            unique_lock<mutex> lk(sleep_mutex);
+            wake.wait(lk,[&]() { return epoch.load()!=e; });
+        }
+        sleepers--;
+    }
+
+private:
+    struct Cell {
+        atomic<size_t> seq;
+        T data;
+    };
+
+    void Wake() {
+        epoch++;
+        if(sleepers.load()!=0) {
+            lock_guard<mutex> lk(sleep_mutex);
+            wake.notify_all();
+        }
+    }
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> head;    // next cell to pop
+    alignas(64) atomic<size_t> tail;    // next cell to push
+    atomic<bool> closed;
+    atomic<int> sleepers;   // threads in Sleep()
+    atomic<size_t> epoch;   // number of pushes, pops and Close()s
+    mutex sleep_mutex;
+    condition_variable wake;
+};
+
+// Number of threads of each stage, batch size and queue capacity
+struct PipelineConfig {
+    int parse_threads;
+    int build_threads;
+    int analyze_threads;
+    int batch_size;     // records per batch
+    int queue_capacity; // batches per queue
+
+    PipelineConfig() : parse_threads(1), build_threads(1), analyze_threads(1),
+        batch_size(64), queue_capacity(16) {}
+};
+
+// Counters of a stage, all times in nanoseconds
+struct StageStats {
+    string name;
+    uint64_t items;
+    uint64_t batches;
+    uint64_t busy_ns;       // time spent processing batches
+    uint64_t max_batch_ns;  // processing time of the slowest batch
+    uint64_t blocked_ns;    // time waiting on a full output queue
+    uint64_t idle_ns;       // time waiting on an empty input queue
+    uint64_t latency_ns;    // sum of the time from reading a batch to finishing it here
+};
+
+class TreePipeline {
+public:
+    // Called for every tree with its record number(0-based line number of non-empty lines)
+    typedef function<void(size_t,BinaryTree&)> Analysis;
+
+    TreePipeline(Analysis fn, PipelineConfig cfg=PipelineConfig()) : analysis(fn), config(cfg) {
+        const char* names[]={"read","parse","build","analyze"};
+        for(int i=0;i<STAGES;++i) {
+            counters[i].name=names[i];
+            counters[i].Reset();
+        }
+        wall_ns=0;
+    }
+
+    //
+    // Run all records of the input stream through the pipeline, and return
+    // when all of them have been analyzed. Returns the number of records.
+    //
+    size_t Run(istream& in) {
+        typedef Batch<string> LineBatch;
+        typedef Batch<vector<string> > TokenBatch;
+        typedef Batch<BinaryTree*> BuiltBatch;
+
+        BoundedQueue<LineBatch*> lines(config.queue_capacity);
+        BoundedQueue<TokenBatch*> tokens(config.queue_capacity);
+        BoundedQueue<BuiltBatch*> trees(config.queue_capacity);
+        for(int i=0;i<STAGES;++i)
+            counters[i].Reset();
+        Clock::time_point start=Clock::now();
+
+        vector<thread> workers;
+        atomic<int> parsers(config.parse_threads);
+        for(int i=0;i<config.parse_threads;++i)
+            workers.push_back(thread([&]() {
+                RunStage(lines,&tokens,parsers,counters[PARSE],
+                    [](LineBatch* b, TokenBatch* out) {
+                        for(auto& line:b->items) {
+                            out->items.push_back(Tokenize(line));
+                            if(!ValidTokens(out->items.back())) {
+                                cerr<<"Error: bad record "<<b->first+out->items.size()-1<<endl;
+                                out->items.back().clear();  // analyzed as an empty tree
+                            }
+                        }
+                    });
+            }));
+
+        atomic<int> builders(config.build_threads);
+        for(int i=0;i<config.build_threads;++i)
+            workers.push_back(thread([&]() {
+                RunStage(tokens,&trees,builders,counters[BUILD],
+                    [](TokenBatch* b, BuiltBatch* out) {
+                        for(auto& t:b->items)
+                            out->items.push_back(new BinaryTree(t));
+                    });
+            }));
+
+        atomic<int> analyzers(config.analyze_threads);
+        for(int i=0;i<config.analyze_threads;++i)
+            workers.push_back(thread([&]() {
+                RunStage(trees,(BoundedQueue<BuiltBatch*>*)NULL,analyzers,counters[ANALYZE],
+                    [&](BuiltBatch* b, BuiltBatch*) {
+                        for(size_t k=0;k<b->items.size();++k) {
+                            analysis(b->first+k,*(b->items[k]));
+                            delete b->items[k];
+                        }
+                    });
+            }));
+
+        // Read stage on the calling thread
+        size_t records=0;
+        string line;
+        LineBatch* batch=NULL;
+        Counters& rc=counters[READ];
+        Clock::time_point t0=Clock::now();
+        while(getline(in,line)) {
+            if(line.find_first_not_of(" \t\r{}")==string::npos)
+                continue;   // skip empty records
+            if(batch==NULL) {
+                batch=new LineBatch(records,t0);
+            }
+            batch->items.push_back(line);
+            records++;
+            if((int)batch->items.size()==config.batch_size) {
+                rc.Done(batch->items.size(),t0,batch->created);
+                Push(lines,batch,rc);
+                batch=NULL;
+                t0=Clock::now();
+            }
+        }
+        if(batch!=NULL) {
+            rc.Done(batch->items.size(),t0,batch->created);
+            Push(lines,batch,rc);
+        }
+        lines.Close();
+
+        for(auto& w:workers)
+            w.join();
+        wall_ns=Nanos(start,Clock::now());
+        return records;
+    }
+
+    // Counters of the read, parse, build and analyze stages of the last Run()
+    vector<StageStats> Stats() {
+        vector<StageStats> stats;
+        for(int i=0;i<STAGES;++i)
+            stats.push_back(counters[i].Snapshot());
+        return stats;
+    }
+
+    // Wall time of the last Run()
+    uint64_t WallTimeNs() { return wall_ns; }
+
+    // Split a record such as "{1,2,#,3}" into tokens
+    static vector<string> Tokenize(const string& line) {
+        vector<string> t;
+        string tok;
+        for(auto& c:line) {
+            if(c==',') {
+                t.push_back(tok);
+                tok.clear();
+            } else if(c!='{' && c!='}' && c!=' ' && c!='\t' && c!='\r') {
+                tok+=c;
+            }
+        }
+        if(!tok.empty() || !t.empty())
+            t.push_back(tok);
+        return t;
+    }
+
+    //
+    // Check that every token is "#" or an int(digits with an optional sign),
+    // so that BuildTree() cannot fail on the record.
+    //
+    static bool ValidTokens(const vector<string>& t) {
+        for(auto& tok:t) {
+            if(tok=="#")
+                continue;
+            bool neg=(!tok.empty() && tok[0]=='-');
+            size_t i=(!tok.empty() && (tok[0]=='-' || tok[0]=='+')) ? 1 : 0;
+            if(i==tok.size())
+                return false;
+            long long v=0;
+            for(;i<tok.size();++i) {
+                if(tok[i]<'0' || tok[i]>'9')
+                    return false;
+                v=v*10+(tok[i]-'0');
+                if(v>(long long)INT_MAX+1)
+                    return false;
+            }
+            if(!neg && v>INT_MAX)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    typedef chrono::steady_clock Clock;
+
+    enum { READ, PARSE, BUILD, ANALYZE, STAGES };
+
+    static const int SPINS=16;  // rounds a waiting thread yields before it sleeps
+
+    // Records first, first+1, ... read at time created
+    template<typename T>
+    struct Batch {
+        size_t first;
+        Clock::time_point created;
+        vector<T> items;
+
+        Batch(size_t f, Clock::time_point c) : first(f), created(c) {}
+    };
+
+    struct Counters {
+        string name;
+        atomic<uint64_t> items, batches, busy_ns, max_batch_ns, blocked_ns, idle_ns, latency_ns;
+
+        void Reset() {
+            items=0; batches=0; busy_ns=0; max_batch_ns=0;
+            blocked_ns=0; idle_ns=0; latency_ns=0;
+        }
+
+        // A batch of n items read at time created was processed since t0
+        void Done(size_t n, Clock::time_point t0, Clock::time_point created) {
+            Clock::time_point now=Clock::now();
+            uint64_t ns=Nanos(t0,now);
+            items+=n;
+            batches++;
+            busy_ns+=ns;
+            latency_ns+=Nanos(created,now);
+            uint64_t mx=max_batch_ns.load();
+            while(ns>mx && !max_batch_ns.compare_exchange_weak(mx,ns));
+        }
+
+        StageStats Snapshot() {
+            StageStats s;
+            s.name=name;
+            s.items=items; s.batches=batches; s.busy_ns=busy_ns; s.max_batch_ns=max_batch_ns;
+            s.blocked_ns=blocked_ns; s.idle_ns=idle_ns; s.latency_ns=latency_ns;
+            return s;
+        }
+    };
+
+    static uint64_t Nanos(Clock::time_point from, Clock::time_point to) {
+        return chrono::duration_cast<chrono::nanoseconds>(to-from).count();
+    }
+
+    // Push to a bounded queue, waiting while it is full
+    template<typename T>
+    static void Push(BoundedQueue<T>& q, T v, Counters& c) {
+        if(q.TryPush(v))
+            return;
+        Clock::time_point t0=Clock::now();
+        for(int spins=0;!q.TryPush(v);++spins) {
+            if(spins<SPINS)
+                this_thread::yield();
+            else
+                q.Sleep([&]() { return !q.Full(); });
+        }
+        c.blocked_ns+=Nanos(t0,Clock::now());
+    }
+
+    // Pop from a bounded queue, waiting while it is empty. Return false once
+    // the queue is closed and drained.
+    template<typename T>
+    static bool Pop(BoundedQueue<T>& q, T& v, Counters& c) {
+        if(q.TryPop(v))
+            return true;
+        Clock::time_point t0=Clock::now();
+        bool got=true;
+        for(int spins=0;!q.TryPop(v);++spins) {
+            if(q.Closed()) {
+                got=q.TryPop(v);  // items pushed right before Close()
+                break;
+            }
+            if(spins<SPINS)
+                this_thread::yield();
+            else
+                q.Sleep([&]() { return !q.Empty() || q.Closed(); });
+        }
+        c.idle_ns+=Nanos(t0,Clock::now());
+        return got;
+    }
+
+    //
+    // Worker loop of a stage: pop a batch, process it into a new batch, and push
+    // the result downstream. The last worker of a stage closes the output queue.
+    //
+    template<typename In, typename Out, typename Fn>
+    static void RunStage(BoundedQueue<In*>& in, BoundedQueue<Out*>* out,
+            atomic<int>& running, Counters& c, Fn fn) {
+        In* b;
+        while(Pop(in,b,c)) {
+            Clock::time_point t0=Clock::now();
+            Out* o=(out!=NULL) ? new Out(b->first,b->created) : NULL;
+            fn(b,o);
+            c.Done(b->items.size(),t0,b->created);
+            delete b;
+            if(out!=NULL)
+                Push(*out,o,c);
+        }
+        if(--running==0 && out!=NULL)
+            out->Close();
+    }
+
+    Analysis analysis;
+    PipelineConfig config;
+    Counters counters[STAGES];
+    uint64_t wall_ns;
+};
+
+#endif // _PIPELINE_H_
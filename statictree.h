@@ -0,0 +1,356 @@
+#ifndef _STATICTREE_H_
+#define _STATICTREE_H_
+
+////////////////////////////////////////////////////////////////
+//
+// Binary trees built at compile time.
+//
+// Fixed trees(test fixtures, lookup tables) built with BuildTree() are parsed
+// with stoi() and allocated on the heap when the program starts. StaticTree
+// is built from the same level-order representation by constexpr functions
+// instead, so a fixed tree is a read-only array in the binary:
+//
+//  1. Nodes are numbered in level order. val[i] is the value of node i, and
+//  left[i]/right[i] are the indexes of its children, or NIL.
+//  2. STATIC_TREE("{7,1,9,0,3,#,#,2}") counts the nodes of the literal and
+//  parses it into a StaticTree of exactly that many nodes.
+//  3. The read-only algorithms(IsBST, HasLoop, traversals, Lookup,
+//  HasPathSum and IsSameTree) are constexpr and run on the arrays, so they
+//  can be checked by static_assert or called at run time without any heap.
+//
+// Example:
+//  constexpr auto t=STATIC_TREE("{7,1,9,0,3,8,10}");
+//  static_assert(t.IsBST() && !t.HasLoop(),"bad fixture");
+//  int v=t.val[t.Lookup(3)];
+//
+// A malformed literal is a compile error when parsed in a constant
+// expression. Requires C++14.
+//
+////////////////////////////////////////////////////////////////
+
+#if __cplusplus < 201402L
+#error "statictree.h requires C++14"
+#endif
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+//
+// Result of a traversal of a StaticTree of up to N nodes.
+//
+template<size_t N>
+struct StaticTrace {
+    int v[N];
+    size_t n;
+
+    constexpr StaticTrace() : v{}, n(0) {}
+
+    constexpr size_t Size() const { return n; }
+
+    constexpr int operator[](size_t i) const { return v[i]; }
+
+    constexpr void PushBack(int x) { v[n++]=x; }
+
+    template<size_t M>
+    constexpr bool operator==(const StaticTrace<M>& o) const {
+        if(n!=o.n)
+            return false;
+        for(size_t i=0;i<n;++i)
+            if(v[i]!=o.v[i])
+                return false;
+        return true;
+    }
+
+    vector<int> ToVector() const { return vector<int>(v,v+n); }
+};
+
+template<size_t N>
+struct StaticTree {
+    static constexpr int NIL=-1;
+    static constexpr size_t CAP=(N>0) ? N : 1;    // arrays cannot be empty
+
+    int val[CAP];
+    int left[CAP];
+    int right[CAP];
+    size_t n;   // number of nodes
+
+    constexpr StaticTree() : val{}, left{}, right{}, n(0) {}
+
+    constexpr size_t Size() const { return n; }
+
+    constexpr int Root() const { return (n>0) ? 0 : NIL; }
+
+    //
+    // Check if a node can be reached twice from the root. Parsed trees never
+    // have loops, but trees whose arrays are modified may.
+    //
+    constexpr bool HasLoop() const {
+        bool seen[CAP]={};
+        int st[2*CAP+1]={};  // every node pushes at most two children
+        size_t top=0;
+        if(n>0)
+            st[top++]=0;
+        while(top>0) {
+            int i=st[--top];
+            if(i<0 || (size_t)i>=n || seen[i])
+                return true;
+            seen[i]=true;
+            if(right[i]!=NIL)
+                st[top++]=right[i];
+            if(left[i]!=NIL)
+                st[top++]=left[i];
+        }
+        return false;
+    }
+
+    //
+    // Check if the tree is a BST: the inorder traversal is strictly
+    // increasing. The tree must not have loops.
+    //
+    constexpr bool IsBST() const {
+        StaticTrace<CAP> tr=InorderTraversal();
+        for(size_t i=1;i<tr.n;++i)
+            if(tr.v[i-1]>=tr.v[i])
+                return false;
+        return true;
+    }
+
+    //
+    // Preorder Traversal:
+    //  (i) Visit the root, (ii) Traverse the left subtree, and
+    //  (iii) Traverse the right subtree.
+    //
+    constexpr StaticTrace<CAP> PreorderTraversal() const {
+        StaticTrace<CAP> trace;
+        int st[CAP+1]={};
+        size_t top=0;
+        if(n>0)
+            st[top++]=0;
+        while(top>0) {
+            int i=st[--top];
+            trace.PushBack(val[i]);
+            if(right[i]!=NIL)
+                st[top++]=right[i];
+            if(left[i]!=NIL)
+                st[top++]=left[i];
+        }
+        return trace;
+    }
+
+    //
+    // Inorder Traversal:
+    //  (i) Traverse the left subtree, (ii) Visit the root, and (iii) Traverse
+    //  the right subtree.
+    //
+    constexpr StaticTrace<CAP> InorderTraversal() const {
+        StaticTrace<CAP> trace;
+        int st[CAP]={};
+        size_t top=0;
+        int i=Root();
+        while(i!=NIL || top>0) {
+            while(i!=NIL) {
+                st[top++]=i;
+                i=left[i];
+            }
+            i=st[--top];
+            trace.PushBack(val[i]);
+            i=right[i];
+        }
+        return trace;
+    }
+
+    //
+    // Postorder Traversal:
+    //  (i) Traverse the left subtree, (ii) Traverse the right subtree, and
+    //  (iii) Visit the root.
+    //
+    constexpr StaticTrace<CAP> PostorderTraversal() const {
+        StaticTrace<CAP> trace;
+        int st[CAP]={};
+        bool expanded[CAP]={};  // subtrees of st[k] already pushed
+        size_t top=0;
+        if(n>0)
+            st[top++]=0;
+        while(top>0) {
+            int i=st[top-1];
+            if(expanded[top-1]) {
+                trace.PushBack(val[i]);
+                top--;
+                continue;
+            }
+            expanded[top-1]=true;
+            if(right[i]!=NIL) {
+                st[top]=right[i];
+                expanded[top++]=false;
+            }
+            if(left[i]!=NIL) {
+                st[top]=left[i];
+                expanded[top++]=false;
+            }
+        }
+        return trace;
+    }
+
+    //
+    // Find the node holding x in a BST. Return its index, or NIL.
+    //
+    constexpr int Lookup(int x) const {
+        int i=Root();
+        while(i!=NIL && val[i]!=x)
+            i=(x<val[i]) ? left[i] : right[i];
+        return i;
+    }
+
+    //
+    // Check if there is a root-to-leaf path whose sum equals sum.
+    //
+    constexpr bool HasPathSum(int sum) const {
+        int st[CAP+1]={};
+        int sums[CAP+1]={};  // sum to now, the node included
+        size_t top=0;
+        if(n>0) {
+            st[top]=0;
+            sums[top++]=val[0];
+        }
+        while(top>0) {
+            --top;
+            int i=st[top], s=sums[top];
+            if(left[i]==NIL && right[i]==NIL && s==sum)
+                return true;
+            if(right[i]!=NIL) {
+                st[top]=right[i];
+                sums[top++]=s+val[right[i]];
+            }
+            if(left[i]!=NIL) {
+                st[top]=left[i];
+                sums[top++]=s+val[left[i]];
+            }
+        }
+        return false;
+    }
+};
+
+template<size_t N>
+constexpr int StaticTree<N>::NIL;
+
+template<size_t N>
+constexpr size_t StaticTree<N>::CAP;
+
+//
+// Read the next token of a level-order literal such as "{1,2,#,3}" from
+// position i. Braces, commas and spaces separate the tokens. Return false at
+// the end of the literal, valid is false for "#".
+//
+constexpr bool StaticNextToken(const char* s, size_t& i, bool& valid, int& v) {
+    while(s[i]=='{' || s[i]=='}' || s[i]==',' || s[i]==' ' || s[i]=='\t' || s[i]=='\n')
+        i++;
+    if(s[i]=='\0')
+        return false;
+    if(s[i]=='#') {
+        i++;
+        valid=false;
+        return true;
+    }
+    bool neg=(s[i]=='-');
+    if(s[i]=='-' || s[i]=='+')
+        i++;
+    if(s[i]<'0' || s[i]>'9')
+        throw "invalid token in tree literal";
+    v=0;
+    while(s[i]>='0' && s[i]<='9')
+        v=v*10+(s[i++]-'0');
+    if(neg)
+        v=-v;
+    valid=true;
+    return true;
+}
+
+//
+// Number of nodes in a level-order literal. As in BuildTree(), tokens without
+// a parent are ignored.
+//
+constexpr size_t StaticTreeSize(const char* s) {
+    size_t i=0, j=0, n=0;
+    bool valid=false;
+    int v=0;
+    for(;StaticNextToken(s,i,valid,v);++j) {
+        if(j>0 && (j-1)/2>=n)
+            break;
+        if(valid)
+            n++;
+    }
+    return n;
+}
+
+//
+// Parse a level-order literal into a tree of N nodes. In the level-order
+// representation the children of the k-th valid node are the tokens 2k+1 and
+// 2k+2, so each node is linked to its parent as soon as it is read.
+//
+template<size_t N>
+constexpr StaticTree<N> ParseStaticTree(const char* s) {
+    StaticTree<N> t;
+    size_t i=0, j=0;
+    bool valid=false;
+    int v=0;
+    for(;StaticNextToken(s,i,valid,v);++j) {
+        size_t p=(j-1)/2;   // the parent of token j
+        if(j>0 && p>=t.n)
+            break;  // tokens without parent are ignored
+        if(!valid)
+            continue;
+        if(t.n>=N)
+            throw "tree literal has more than N nodes";
+        t.val[t.n]=v;
+        t.left[t.n]=StaticTree<N>::NIL;
+        t.right[t.n]=StaticTree<N>::NIL;
+        if(j>0) {
+            if(j%2==1)
+                t.left[p]=(int)t.n;
+            else
+                t.right[p]=(int)t.n;
+        }
+        t.n++;
+    }
+    return t;
+}
+
+//
+// Check if two static trees are structurally identical and the nodes have
+// the same values.
+//
+template<size_t N, size_t M>
+constexpr bool IsSameTree(const StaticTree<N>& p, const StaticTree<M>& q) {
+    if(p.n!=q.n)
+        return false;
+    int sp[StaticTree<N>::CAP+1]={};
+    int sq[StaticTree<N>::CAP+1]={};
+    size_t top=0;
+    if(p.n>0) {
+        sp[top]=0;
+        sq[top++]=0;
+    }
+    while(top>0) {
+        --top;
+        int a=sp[top], b=sq[top];
+        if(p.val[a]!=q.val[b] || (p.left[a]==StaticTree<N>::NIL)!=(q.left[b]==StaticTree<M>::NIL)
+                || (p.right[a]==StaticTree<N>::NIL)!=(q.right[b]==StaticTree<M>::NIL))
+            return false;
+        if(p.right[a]!=StaticTree<N>::NIL) {
+            sp[top]=p.right[a];
+            sq[top++]=q.right[b];
+        }
+        if(p.left[a]!=StaticTree<N>::NIL) {
+            sp[top]=p.left[a];
+            sq[top++]=q.left[b];
+        }
+    }
+    return true;
+}
+
+// Build a StaticTree of exactly the size of a level-order literal
+#define STATIC_TREE(lit) ParseStaticTree<StaticTreeSize(lit)>(lit)
+
+#endif // _STATICTREE_H_
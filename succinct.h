@@ -0,0 +1,399 @@
+#ifndef _SUCCINCT_H_
+#define _SUCCINCT_H_
+
+////////////////////////////////////////////////////////////////
+//
+// Succinct(LOUDS) encoding of binary trees for archival and read-mostly use.
+//
+// A TreeNode costs 24 bytes plus the heap overhead. LoudsTree stores the shape
+// of a tree of n nodes in 2n+1 bits and the values in a packed array, using
+// the level-order representation that BuildTree() already reads:
+//
+//  1. Nodes are numbered 0..n-1 in level order(BFS).
+//  2. Bit 0 is 1(the root), and bits 2i+1 and 2i+2 tell whether node i has a
+//  left and a right child. This is exactly the {1,2,3,#,#,4} input with each
+//  token replaced by 1 and each # by 0.
+//  3. With rank1(p) = number of ones before position p, the child at bit p is
+//  node rank1(p), and the parent of node j is (select1(j)-1)/2, where
+//  select1(j) is the position of the j-th one.
+//  4. Values are stored in level order as (value - min), using only as many
+//  bits per value as max - min needs.
+//
+// Rank takes a superblock count(one 32-bit count per 512 bits) plus at most 8
+// popcounts, so parent, children and sibling are O(1). Select uses a sampled
+// index(one sample per 512 ones) and is O(1) on average. The subtrees of the
+// nodes of one level are contiguous in level order, so SubtreeSize() and the
+// level ranges of ZigzagLevelOrder() take O(1) per level.
+//
+// The traversals and ZigzagLevelOrder() run directly on the encoded form and
+// return the same results as the BinaryTree versions.
+//
+// Example: {1,2,3,#,#,4,#,#,5}
+//  bits:   1 1 1 0 0 1 0 0 1 0 0
+//  values: 1 2 3 4 5
+//
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <algorithm>
+#include "binarytree.h"
+
+using namespace std;
+
+//
+// Bit vector with rank and select support. Supports up to 2^32 bits.
+//
+class RankSelect {
+public:
+    RankSelect() : nbits(0), ones(0) {}
+
+    void PushBack(bool b) {
+        if(nbits%64==0)
+            words.push_back(0);
+        if(b)
+            words.back()|=(uint64_t)1<<(nbits%64);
+        nbits++;
+    }
+
+    // Build the rank and select indexes, called after the last PushBack()
+    void Finalize() {
+        supers.clear();
+        samples.clear();
+        uint32_t cnt=0;
+        for(size_t w=0;w<words.size();++w) {
+            if(w%WORDS_PER_SUPER==0)
+                supers.push_back(cnt);
+            int c=PopCount(words[w]);
+            // Sample the superblock of every SAMPLE-th one
+            while(samples.size()*SAMPLE<cnt+c)
+                samples.push_back(w/WORDS_PER_SUPER);
+            cnt+=c;
+        }
+        supers.push_back(cnt);  // sentinel
+        ones=cnt;
+    }
+
+    bool Get(size_t p) const { return (words[p/64]>>(p%64))&1; }
+
+    size_t Size() const { return nbits; }
+
+    // Number of ones in [0, p)
+    size_t Rank1(size_t p) const {
+        size_t w=p/64;
+        size_t sb=w/WORDS_PER_SUPER;
+        size_t r=supers[sb];
+        for(size_t i=sb*WORDS_PER_SUPER;i<w;++i)
+            r+=PopCount(words[i]);
+        if(p%64!=0)
+            r+=PopCount(words[w]&(((uint64_t)1<<(p%64))-1));
+        return r;
+    }
+
+    // Position of the k-th one(0-based), k must be smaller than the number of ones
+    size_t Select1(size_t k) const {
+        size_t sb=samples[k/SAMPLE];
+        while(supers[sb+1]<=k)
+            sb++;
+        size_t r=k-supers[sb];
+        size_t w=sb*WORDS_PER_SUPER;
+        while(true) {
+            size_t c=PopCount(words[w]);
+            if(r<c)
+                break;
+            r-=c;
+            w++;
+        }
+        uint64_t x=words[w];
+        for(;r>0;--r)
+            x&=x-1; // clear the lowest one
+        return w*64+CountTrailingZeros(x);
+    }
+
+    size_t MemoryBytes() const {
+        return words.size()*sizeof(uint64_t)+supers.size()*sizeof(uint32_t)+samples.size()*sizeof(uint32_t);
+    }
+
+private:
+    static const size_t WORDS_PER_SUPER=8;  // 512 bits per superblock
+    static const size_t SAMPLE=512;         // ones per select sample
+
+    static int PopCount(uint64_t x) {
+#if defined(__GNUC__)
+        return __builtin_popcountll(x);
+#else
+        int c=0;
+        for(;x!=0;x&=x-1)
+            c++;
+        return c;
+#endif
+    }
+
+    static int CountTrailingZeros(uint64_t x) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(x);
+#else
+        int c=0;
+        for(;(x&1)==0;x>>=1)
+            c++;
+        return c;
+#endif
+    }
+
+    vector<uint64_t> words;
+    vector<uint32_t> supers;    // number of ones before each superblock
+    vector<uint32_t> samples;   // superblock containing the (i*SAMPLE)-th one
+    size_t nbits;
+    size_t ones;
+};
+
+//
+// Array of integers stored as (value - min) with the fewest bits per value.
+//
+class PackedArray {
+public:
+    PackedArray() : width(0), base(0), n(0) {}
+
+    void Init(const vector<int>& v) {
+        n=v.size();
+        words.clear();
+        width=0;
+        base=0;
+        if(v.empty())
+            return;
+        long long mn=v[0], mx=v[0];
+        for(auto& x:v) {
+            mn=min(mn,(long long)x);
+            mx=max(mx,(long long)x);
+        }
+        base=mn;
+        while(width<64 && ((uint64_t)(mx-mn)>>width)!=0)
+            width++;
+        words.assign((n*width+63)/64+1,0);
+        for(size_t i=0;i<n;++i) {
+            uint64_t d=(uint64_t)(v[i]-mn);
+            size_t bit=i*width;
+            words[bit/64]|=d<<(bit%64);
+            if(bit%64+width>64)
+                words[bit/64+1]|=d>>(64-bit%64);
+        }
+    }
+
+    int Get(size_t i) const {
+        if(width==0)
+            return (int)base;
+        size_t bit=i*width;
+        uint64_t x=words[bit/64]>>(bit%64);
+        if(bit%64+width>64)
+            x|=words[bit/64+1]<<(64-bit%64);
+        x&=((uint64_t)1<<width)-1;
+        return (int)(base+(long long)x);
+    }
+
+    size_t MemoryBytes() const { return words.size()*sizeof(uint64_t); }
+
+private:
+    vector<uint64_t> words;
+    int width;      // bits per value
+    long long base; // minimum value
+    size_t n;
+};
+
+class LoudsTree {
+public:
+    static const size_t NIL=(size_t)-1;   // no such node
+
+    //
+    // Encode a tree from its level-order representation such as {1,2,3,#,#,4},
+    // where "#" means invalid node.
+    //
+    LoudsTree(vector<string>& t) {
+        vector<int> vals;
+        for(size_t j=0;j<t.size();++j) {
+            if(j>0 && (j-1)/2>=vals.size())
+                break;  // tokens without parent are ignored
+            bool valid=(t[j]!="#");
+            bits.PushBack(valid);
+            if(valid)
+                vals.push_back(stoi(t[j]));
+        }
+        Finish(vals);
+    }
+
+    //
+    // Encode a tree of TreeNodes. The tree must not contain loops or shared
+    // subtrees.
+    //
+    LoudsTree(TreeNode* root) {
+        vector<int> vals;
+        bits.PushBack(root!=NULL);
+        queue<TreeNode*> q;
+        if(root!=NULL)
+            q.push(root);
+        while(!q.empty()) {
+            TreeNode* node=q.front();
+            q.pop();
+            vals.push_back(node->val);
+            bits.PushBack(node->left!=NULL);
+            bits.PushBack(node->right!=NULL);
+            if(node->left!=NULL)
+                q.push(node->left);
+            if(node->right!=NULL)
+                q.push(node->right);
+        }
+        Finish(vals);
+    }
+
+    size_t Size() { return n; }
+
+    int Value(size_t i) { return values.Get(i); }
+
+    size_t Left(size_t i) { return Child(2*i+1); }
+
+    size_t Right(size_t i) { return Child(2*i+2); }
+
+    bool IsLeaf(size_t i) { return !bits.Get(2*i+1) && !bits.Get(2*i+2); }
+
+    size_t Parent(size_t i) {
+        if(i==0 || i>=n)
+            return NIL;
+        return (bits.Select1(i)-1)/2;
+    }
+
+    // The other child of the parent
+    size_t Sibling(size_t i) {
+        if(i==0 || i>=n)
+            return NIL;
+        size_t p=bits.Select1(i);
+        return Child((p%2==1) ? p+1 : p-1);
+    }
+
+    //
+    // Number of nodes in the subtree of node i. The descendants of i on each
+    // level are contiguous in level order, so the subtree is walked one level
+    // at a time: the children of nodes [a,b] are the ones in bits [2a+1,2b+2].
+    //
+    size_t SubtreeSize(size_t i) {
+        size_t size=0;
+        if(i>=n)
+            return 0;
+        size_t a=i, b=i+1;  // nodes [a,b) of current level
+        while(a<b) {
+            size+=b-a;
+            a=bits.Rank1(2*a+1);
+            b=bits.Rank1(2*b+1);
+        }
+        return size;
+    }
+
+    //
+    // Preorder Traversal:
+    //  (i) Visit the root, (ii) Traverse the left subtree, and
+    //  (iii) Traverse the right subtree.
+    //
+    vector<int> PreorderTraversal(size_t rt=0) {
+        vector<int> trace;
+        stack<size_t> st;
+        if(rt<n)
+            st.push(rt);
+        while(!st.empty()) {
+            size_t i=st.top();
+            st.pop();
+            trace.push_back(Value(i));
+            size_t r=Right(i), l=Left(i);
+            if(r!=NIL)
+                st.push(r);
+            if(l!=NIL)
+                st.push(l);
+        }
+        return trace;
+    }
+
+    //
+    // Inorder Traversal:
+    //  (i) Traverse the left subtree, (ii) Visit the root, and (iii) Traverse
+    //  the right subtree.
+    //
+    vector<int> InorderTraversal(size_t rt=0) {
+        vector<int> trace;
+        stack<size_t> st;
+        size_t i=(rt<n) ? rt : NIL;
+        while(i!=NIL || !st.empty()) {
+            while(i!=NIL) {
+                st.push(i);
+                i=Left(i);
+            }
+            i=st.top();
+            st.pop();
+            trace.push_back(Value(i));
+            i=Right(i);
+        }
+        return trace;
+    }
+
+    //
+    // Postorder Traversal:
+    //  (i) Traverse the left subtree, (ii) Traverse the right subtree, and
+    //  (iii) Visit the root.
+    //
+    vector<int> PostorderTraversal(size_t rt=0) {
+        vector<int> trace;
+        stack<pair<size_t,bool> > st; // <node, subtrees already pushed>
+        if(rt<n)
+            st.push(make_pair(rt,false));
+        while(!st.empty()) {
+            size_t i=st.top().first;
+            if(st.top().second) {
+                trace.push_back(Value(i));
+                st.pop();
+                continue;
+            }
+            st.top().second=true;
+            size_t r=Right(i), l=Left(i);
+            if(r!=NIL)
+                st.push(make_pair(r,false));
+            if(l!=NIL)
+                st.push(make_pair(l,false));
+        }
+        return trace;
+    }
+
+    //
+    // Zigzag level order traversal. Each level is a contiguous range of node
+    // ids, so no queue is needed.
+    //
+    vector<vector<int> > ZigzagLevelOrder() {
+        vector<vector<int> > trace;
+        bool l2r=true;
+        size_t a=0, b=(n>0) ? 1 : 0;
+        while(a<b) {
+            vector<int> level;
+            for(size_t k=0;k<b-a;++k)
+                level.push_back(Value(l2r ? a+k : b-1-k));
+            trace.push_back(level);
+            a=bits.Rank1(2*a+1);
+            b=bits.Rank1(2*b+1);
+            l2r=!l2r;
+        }
+        return trace;
+    }
+
+    size_t MemoryBytes() { return bits.MemoryBytes()+values.MemoryBytes(); }
+
+private:
+    void Finish(const vector<int>& vals) {
+        n=vals.size();
+        while(bits.Size()<2*n+1)
+            bits.PushBack(false);   // missing tokens at the end
+        bits.Finalize();
+        values.Init(vals);
+    }
+
+    // The node at bit p, or NIL
+    size_t Child(size_t p) { return bits.Get(p) ? bits.Rank1(p) : NIL; }
+
+    RankSelect bits;
+    PackedArray values;
+    size_t n;   // number of nodes
+};
+
+#endif // _SUCCINCT_H_
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <stdexcept>
+#include "batchtree.h"
+
+using namespace std;
+
+int main() {
+	vector<vector<string> > trees={
+		{"1","2","3","#","#","4","#","5","6"},
+		{"1","2","3","#","#","#","4","5","6"},
+		{"7","1","9","0","3","8","10","#","#","2","5","#","#","#","#","#","#","4","6"},
+		{"1","#","2","#","3","#","4"},
+		{"6","3","8","1","7","#","9"},
+		{"5","4","8","11","#","13","4","7","2","#","#","5","1"},
+		{"-2","#","-3"}
+	};
+
+	TreeBatch batch(3);
+	batch.Build(trees);
+
+	BatchResults res;
+	int all=BATCH_PREORDER|BATCH_INORDER|BATCH_POSTORDER|BATCH_IS_BST|BATCH_HAS_LOOP|BATCH_PATH_SUM;
+	batch.Analyze(all,22,res);
+
+	BinaryTree bt;
+	for(int i=0;i<batch.NumTrees();++i) {
+		cout<<"\nBinary Tree "<<i+1<<":"<<endl;
+		bt.PrintTree(batch.GetRoot(i));
+		vector<int> vec(res.preorder.begin()+res.offsets[i],res.preorder.begin()+res.offsets[i+1]);
+		bt.PrintTraversal(vec,"Preorder");
+		vec.assign(res.inorder.begin()+res.offsets[i],res.inorder.begin()+res.offsets[i+1]);
+		bt.PrintTraversal(vec,"Inorder");
+		vec.assign(res.postorder.begin()+res.offsets[i],res.postorder.begin()+res.offsets[i+1]);
+		bt.PrintTraversal(vec,"Postorder");
+		cout<<(res.is_bst[i] ? "Binary Search Tree!" : "Not BST!")<<endl;
+		cout<<(res.has_loop[i] ? "Detected cycle in binary tree." : "No loop found.")<<endl;
+		cout<<"Paths to sum 22: "<<res.path_sums[i]<<endl;
+	}
+
+	// A bad token in any thread's range is reported to the caller
+	vector<vector<string> > bad={{"1","2"},{"1","x"}};
+	try {
+		batch.Build(bad);
+	} catch(invalid_argument& e) {
+		cout<<"\nBad token, "<<batch.NumTrees()<<" trees built"<<endl;
+	}
+	batch.Analyze(all,22,res);
+
+	return 0;
+}
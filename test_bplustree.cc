@@ -0,0 +1,65 @@
+#include <iostream>
+#include <algorithm>
+#include "bplustree.h"
+
+using namespace std;
+
+int main() {
+	vector<string> tree={"7","1","9","0","3","8","10","#","#","2","5","#","#","#","#","#","#","4","6"};
+
+	cout<<"\nBinary Search Tree:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	bt.PrintTree(t);
+
+	// Small nodes so that a few keys already need several levels
+	BPlusTree<64> bp;
+	bp.BulkLoad(bt.InorderTraversal(t));
+	for(int x:{12,-3,5,11,20,15,13,14,16,17,18,19,21,22,23,-1,-2})
+		bp.Insert(x);
+	cout<<"\nB+ tree of "<<bp.Size()<<" keys, "<<bp.Height()<<" levels:"<<endl;
+	vector<int> keys=bp.InorderTraversal();
+	for(auto& k:keys)
+		cout<<k<<" ";
+	cout<<endl;
+	cout<<"Min "<<bp.Min()<<", max "<<bp.Max()<<endl;
+	for(int x:{5,6,24,-4}) {
+		int k;
+		cout<<x<<(bp.Contains(x) ? " found" : " not found");
+		if(bp.LowerBound(x,k))
+			cout<<", lower bound "<<k;
+		cout<<endl;
+	}
+
+	// Random inserts, checked against a sorted vector
+	const int N=1000000;
+	BPlusTree<> big;
+	vector<int> ref;
+	srand(1);
+	for(int i=0;i<N;++i) {
+		int x=rand()%(4*N);
+		if(big.Insert(x))
+			ref.push_back(x);
+	}
+	sort(ref.begin(),ref.end());
+	bool ok=(big.InorderTraversal()==ref);
+	for(int i=0;i<10000 && ok;++i) {
+		int x=rand()%(4*N+10)-5, k;
+		auto it=lower_bound(ref.begin(),ref.end(),x);
+		bool found=big.LowerBound(x,k);
+		ok=(found==(it!=ref.end())) && (!found || k==*it);
+	}
+	cout<<"\n"<<big.Size()<<" random keys: "<<big.Height()<<" levels, "
+		<<big.MemoryBytes()/big.Size()<<" bytes per key, "<<(ok ? "same as sorted" : "WRONG")<<endl;
+
+	BPlusTree<> loaded;
+	loaded.BulkLoad(ref);
+	ok=(loaded.InorderTraversal()==ref);
+	for(int i=0;i<10000 && ok;++i) {
+		int x=rand()%(4*N);
+		ok=(loaded.Contains(x)==binary_search(ref.begin(),ref.end(),x));
+	}
+	cout<<"Bulk loaded: "<<loaded.Height()<<" levels, "<<(ok ? "same as sorted" : "WRONG")<<endl;
+
+	return 0;
+}
@@ -15,5 +15,30 @@ int main() {
 	else
 		cout<<"Not BST!"<<endl;
 
+	// Fix the offending node and check again
+	TreeNode* n=t->left->right;
+	n->val=4;
+	bt.MarkDirty(n);
+	cout<<"\nAfter changing 7 to 4:"<<endl;
+	bt.PrintTree(t);
+	if(bt.IsBST(t))
+		cout<<"Binary Search Tree!"<<endl;
+	else
+		cout<<"Not BST!"<<endl;
+
+	// Trees owned by other BinaryTrees are not cached, so a tree built at
+	// the address of a freed one is checked again
+	BinaryTree algo;
+	{
+		vector<string> tree1={"2","1","3"};
+		BinaryTree x(tree1);
+		cout<<"\nForeign tree {2,1,3}: "<<(algo.IsBST(x.GetRoot()) ? "Binary Search Tree!" : "Not BST!")<<endl;
+	}
+	{
+		vector<string> tree2={"2","3","1"};
+		BinaryTree y(tree2);
+		cout<<"Foreign tree {2,3,1}: "<<(algo.IsBST(y.GetRoot()) ? "Binary Search Tree!" : "Not BST!")<<endl;
+	}
+
 	return 0;
 }
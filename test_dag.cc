@@ -0,0 +1,50 @@
+#include <iostream>
+#include "binarytree.h"
+
+using namespace std;
+
+int main() {
+	// Both subtrees of the root are 2(3(5,6),4(5,6))
+	vector<string> tree={"1","2","2","3","4","3","4","5","6","5","6","5","6","5","6"};
+
+	cout<<"\nBinary Tree:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	bt.PrintTree(t);
+	vector<int> pre=bt.PreorderTraversal(t);
+	vector<vector<int> > paths=bt.PathSum(t,11);
+	size_t before=bt.NumNodes();
+
+	t=bt.CompactDAG();
+	cout<<"\nNodes before: "<<before<<", after compaction: "<<bt.NumNodes()<<endl;
+	if(t->left==t->right)
+		cout<<"Both subtrees of the root share one node."<<endl;
+	vector<int> vec=bt.PreorderTraversal(t);
+	bt.PrintTraversal(vec,"Preorder");
+	if(vec==pre && bt.PathSum(t,11)==paths)
+		cout<<"Traversal and path sums are unchanged."<<endl;
+
+	// A traversal buffer needs TraceLength() entries, not NumNodes()
+	TraversalWorkspace ws=bt.MakeWorkspace();
+	vector<int> buf(bt.TraceLength());
+	bt.PreorderTraversal(t,ws,buf.begin());
+	cout<<"Trace length: "<<bt.TraceLength()<<(buf==pre ? ", same as the preorder traversal" : " (WRONG)")<<endl;
+	cout<<"Paths to sum 11 are:"<<endl;
+	bt.PrintPath(paths);
+
+	if(bt.HasLoop(t))
+		cout<<"Detected cycle in binary tree."<<endl;
+	else
+		cout<<"No loop found."<<endl;
+
+	// Link a leaf back to the root: now it is a real cycle
+	TreeNode* leaf=t->left->left->left;
+	leaf->left=t;
+	if(bt.HasLoop(t))
+		cout<<"Detected cycle in binary tree."<<endl;
+	else
+		cout<<"No loop found."<<endl;
+	leaf->left=NULL;
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include "interleave.h"
+
+using namespace std;
+
+int main() {
+	vector<string> tree={"7","1","9","0","3","8","10","#","#","2","5","#","#","#","#","#","#","4","6"};
+	vector<string> tree2={"5","4","8","11","#","13","4","7","2","#","#","5","1"};
+
+	cout<<"\nBinary Search Tree:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	bt.PrintTree(t);
+	BinaryTree bt2(tree2);
+	TreeNode* t2=bt2.GetRoot();
+
+	InterleavedWalker walker(4);
+
+	vector<int> keys={4,11,7,0,-1,10,6,3,2,12};
+	vector<TreeNode*> found;
+	walker.Lookup(t,keys,found);
+	cout<<"\nLookup:"<<endl;
+	for(size_t i=0;i<keys.size();++i)
+		cout<<keys[i]<<(found[i]!=NULL ? " found" : " not found")<<endl;
+
+	vector<TreeNode*> roots={t,t2,t2,t,NULL,t2};
+	vector<int> sums={22,22,26,17,0,18};
+	vector<char> res;
+	walker.HasPathSum(roots,sums,res);
+	cout<<"\nPath sums:"<<endl;
+	for(size_t i=0;i<roots.size();++i) {
+		bool expected=roots[i]!=NULL && !bt.PathSum(roots[i],sums[i]).empty();
+		cout<<"Tree "<<(roots[i]==t ? 1 : roots[i]==t2 ? 2 : 0)<<", sum "<<sums[i]<<": "
+			<<(res[i] ? "found" : "not found")<<(res[i]==expected ? "" : " (WRONG)")<<endl;
+	}
+
+	vector<TreeNode*> p={t,t,t2,NULL,t->left};
+	vector<TreeNode*> q={t,t2,t2,NULL,t->right};
+	walker.IsSameTree(p,q,res);
+	cout<<"\nSame tree:"<<endl;
+	for(size_t i=0;i<p.size();++i)
+		cout<<"Pair "<<i<<": "<<(res[i] ? "same" : "different")
+			<<(res[i]==bt.IsSameTree(p[i],q[i]) ? "" : " (WRONG)")<<endl;
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include "binarytree.h"
+
+using namespace std;
+
+void PrintMetrics(TreeMetrics& m) {
+	cout<<"size "<<m.size<<", height "<<m.height<<", width "<<m.width
+		<<", min "<<m.min<<", max "<<m.max<<", sum "<<m.sum<<endl;
+	cout<<(m.is_bst ? "BST" : "not BST")<<", balance factor "<<m.balance_factor
+		<<(m.balanced ? " (balanced)" : " (not balanced)")<<", leaves "<<m.leaves
+		<<", diameter "<<m.diameter<<", paths to sum "<<m.path_sums<<endl;
+	if(m.has_loop)
+		cout<<"Detected cycle in binary tree."<<endl;
+}
+
+int main() {
+	vector<string> tree1={"7","1","9","0","3","8","10","#","#","2","5","#","#","#","#","#","#","4","6"};
+	vector<string> tree2={"5","4","8","11","#","13","4","7","2","#","#","5","1"};
+
+	cout<<"\nBinary Tree 1:"<<endl;
+	BinaryTree bt1(tree1);
+	TreeNode* t1=bt1.GetRoot();
+	bt1.PrintTree(t1);
+	TreeMetrics m=bt1.Analyze<METRIC_ALL>(t1,22);
+	PrintMetrics(m);
+
+	cout<<"\nBinary Tree 2:"<<endl;
+	BinaryTree bt2(tree2);
+	TreeNode* t2=bt2.GetRoot();
+	bt2.PrintTree(t2);
+	m=bt2.Analyze<METRIC_ALL>(t2,22);
+	PrintMetrics(m);
+
+	// Only height and width, as ZigzagLevelOrder() would give
+	m=bt2.Analyze<METRIC_HEIGHT|METRIC_WIDTH>(t2);
+	vector<vector<int> > tr=bt2.ZigzagLevelOrder(t2);
+	size_t width=0;
+	for(auto& layer:tr)
+		width=max(width,layer.size());
+	cout<<"\nHeight "<<m.height<<", width "<<m.width;
+	if(m.height==(int)tr.size() && m.width==width)
+		cout<<" (same as zigzag level order)";
+	cout<<endl;
+
+	// A loop is reported instead of measured, also far below the root
+	vector<string> tree3={"1","2","3"};
+	vector<string> links={"3->1"};
+	BinaryTree bt3(tree3);
+	TreeNode* t3=bt3.BuildCycleTree(bt3.GetRoot(),links);
+	cout<<"\nBinary Tree 3 with link 3->1:"<<endl;
+	m=bt3.Analyze<METRIC_BST>(t3);
+	PrintMetrics(m);
+
+	vector<string> chain={"0"};
+	for(int i=1;i<100;++i) {
+		chain.push_back("#");
+		chain.push_back(to_string(i));
+	}
+	BinaryTree bt4(chain);
+	TreeNode* t4=bt4.GetRoot();
+	cout<<"\nChain of 100 nodes:"<<endl;
+	m=bt4.Analyze<METRIC_SIZE|METRIC_HEIGHT|METRIC_BST>(t4);
+	PrintMetrics(m);
+	vector<string> back={"99->90"};
+	t4=bt4.BuildCycleTree(t4,back);
+	cout<<"With link 99->90:"<<endl;
+	m=bt4.Analyze<METRIC_SIZE>(t4);
+	PrintMetrics(m);
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include "binarytree.h"
+
+using namespace std;
+
+int main() {
+	vector<string> tree={"5","3","8","1","4","#","9"};
+
+	cout<<"\nVersion 0:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t0=bt.GetRoot();
+	bt.PrintTree(t0);
+	int v0=bt.Snapshot(t0);
+
+	// Each update copies only the path to the changed node
+	TreeNode* t1=bt.InsertBST(bt.GetVersion(v0),7);
+	int v1=bt.Snapshot(t1);
+	TreeNode* t2=bt.InsertBST(bt.GetVersion(v1),2);
+	int v2=bt.Snapshot(t2);
+	TreeNode* t3=bt.SetValue(bt.GetVersion(v2),"LR",6);
+	int v3=bt.Snapshot(t3);
+
+	for(int v=0;v<bt.NumVersions();++v) {
+		TreeNode* t=bt.GetVersion(v);
+		cout<<"\nVersion "<<v<<":"<<endl;
+		bt.PrintTree(t);
+		vector<int> vec=bt.InorderTraversal(t);
+		bt.PrintTraversal(vec,"Inorder");
+		if(bt.IsBST(t))
+			cout<<"Binary Search Tree!"<<endl;
+		else
+			cout<<"Not BST!"<<endl;
+	}
+
+	// Version 3 built from scratch
+	vector<string> tree3={"5","3","8","1","6","7","9","#","2"};
+	BinaryTree expected(tree3);
+	if(bt.IsSameTree(bt.GetVersion(v3),expected.GetRoot()))
+		cout<<"\nVersion 3 is the same as the tree built from scratch."<<endl;
+	if(!bt.IsSameTree(t0,t1))
+		cout<<"Versions 0 and 1 are different trees."<<endl;
+	if(t2->right==t1->right)
+		cout<<"Versions 1 and 2 share the right subtree."<<endl;
+
+	// Release the nodes only used by versions 1 and 2
+	size_t before=bt.NumNodes();
+	bt.DropVersion(v1);
+	bt.DropVersion(v2);
+	size_t released=bt.Collect();
+	cout<<"\nDropped versions 1 and 2: "<<released<<" of "<<before<<" nodes released."<<endl;
+	if(bt.IsSameTree(bt.GetVersion(v3),expected.GetRoot()) && bt.IsSameTree(bt.GetVersion(v0),t0))
+		cout<<"Versions 0 and 3 are unchanged."<<endl;
+
+	return 0;
+}
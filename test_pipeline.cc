@@ -0,0 +1,77 @@
+#include <iostream>
+#include <sstream>
+#include <mutex>
+#include "pipeline.h"
+
+using namespace std;
+
+int main() {
+	string fixtures[]={
+		"{1,2,3,#,#,4,#,5,6}",
+		"{7,1,9,0,3,8,10,#,#,2,5,#,#,#,#,#,#,4,6}",
+		"{1,#,2,#,3,#,4}",
+		"{6,3,8,1,7,#,9}",
+		"{5,4,8,11,#,13,4,7,2,#,#,5,1}"
+	};
+
+	// A stream of records
+	stringstream ss;
+	int n=10000;
+	for(int i=0;i<n;++i)
+		ss<<fixtures[i%5]<<"\n";
+
+	atomic<int> bst(0);
+	atomic<long long> nodes(0);
+	mutex mtx;
+	vector<int> first_preorder;
+	PipelineConfig cfg;
+	cfg.parse_threads=2;
+	cfg.build_threads=2;
+	cfg.analyze_threads=2;
+	cfg.batch_size=32;
+	cfg.queue_capacity=4;
+	TreePipeline pipe([&](size_t rec, BinaryTree& bt) {
+		TreeNode* t=bt.GetRoot();
+		if(bt.IsBST(t))
+			bst++;
+		vector<int> vec=bt.PreorderTraversal(t);
+		nodes+=vec.size();
+		if(rec==0) {
+			lock_guard<mutex> lock(mtx);
+			first_preorder=vec;
+		}
+	},cfg);
+	size_t records=pipe.Run(ss);
+
+	cout<<"\nRecords: "<<records<<endl;
+	cout<<"Binary search trees: "<<bst<<endl;
+	cout<<"Nodes: "<<nodes<<endl;
+	BinaryTree bt;
+	bt.PrintTraversal(first_preorder,"Preorder(record 0)");
+
+	vector<StageStats> stats=pipe.Stats();
+	for(auto& s:stats) {
+		cout<<s.name<<": "<<s.items<<" items, "<<s.batches<<" batches";
+		// Times change from run to run, only check that they were measured
+		if(s.batches>0 && (s.busy_ns==0 || s.latency_ns==0))
+			cout<<", no timing";
+		cout<<endl;
+	}
+	if(pipe.WallTimeNs()==0)
+		cout<<"No wall time"<<endl;
+
+	// Malformed records: a token without a parent is ignored, a bad token
+	// makes an empty tree
+	stringstream bad("{1,#,#,5}\n{1,x}\n{3,1,#,#,2}\n");
+	vector<size_t> sizes(3);
+	TreePipeline check([&](size_t rec, BinaryTree& bt) {
+		sizes[rec]=bt.PreorderTraversal(bt.GetRoot()).size();
+	});
+	check.Run(bad);
+	cout<<"\nNodes of malformed records:";
+	for(auto& n:sizes)
+		cout<<" "<<n;
+	cout<<endl;
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <algorithm>
+#include "binarytree.h"
+
+using namespace std;
+
+// Print the values of all nodes of a tree in memory order
+void PrintMemoryOrder(TreeNode* root) {
+	vector<TreeNode*> nodes;
+	vector<TreeNode*> st;
+	if(root!=NULL)
+		st.push_back(root);
+	while(!st.empty()) {
+		TreeNode* n=st.back();
+		st.pop_back();
+		nodes.push_back(n);
+		if(n->left!=NULL) st.push_back(n->left);
+		if(n->right!=NULL) st.push_back(n->right);
+	}
+	sort(nodes.begin(),nodes.end(),less<TreeNode*>());
+	cout<<"Memory order: ";
+	for(auto& n:nodes)
+		cout<<n->val<<" ";
+	cout<<endl;
+}
+
+int main() {
+	vector<string> tree={"1","2","3","4","5","6","7","8","9","10","11","12","13","14","15"};
+
+	cout<<"\nBinary Tree:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	bt.PrintTree(t);
+
+	// An older version shares most nodes with the current tree
+	int v=bt.Snapshot(t);
+	int v1=bt.Snapshot(bt.SetValue(t,"RL",60));
+
+	// Both versions built from scratch, and traversals of version 1 before
+	// any relayout
+	BinaryTree expected(tree);
+	vector<string> tree1=tree;
+	tree1[5]="60";
+	BinaryTree expected1(tree1);
+	vector<int> pre1=bt.PreorderTraversal(bt.GetVersion(v1));
+	vector<int> in1=bt.InorderTraversal(bt.GetVersion(v1));
+
+	NodeLayout orders[]={LAYOUT_PREORDER,LAYOUT_BFS,LAYOUT_VEB};
+	string names[]={"Preorder","BFS","vEB"};
+	for(int i=0;i<3;++i) {
+		bt.Relayout(orders[i]);
+		t=bt.GetRoot();
+		cout<<"\n"<<names[i]<<" layout:"<<endl;
+		PrintMemoryOrder(t);
+		if(bt.IsSameTree(t,expected.GetRoot()) && bt.IsSameTree(bt.GetVersion(v),expected.GetRoot()))
+			cout<<"Tree is unchanged."<<endl;
+		TreeNode* t1=bt.GetVersion(v1);
+		if(bt.IsSameTree(t1,expected1.GetRoot()) && bt.PreorderTraversal(t1)==pre1
+				&& bt.InorderTraversal(t1)==in1)
+			cout<<"Version 1 is unchanged."<<endl;
+		vector<int> vec=bt.PreorderTraversal(t1);
+		bt.PrintTraversal(vec,"Preorder(version 1)");
+	}
+
+	return 0;
+}
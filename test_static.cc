@@ -0,0 +1,45 @@
+#include <iostream>
+#include "binarytree.h"
+#include "statictree.h"
+
+using namespace std;
+
+// Fixtures parsed at compile time
+constexpr auto bst=STATIC_TREE("{7,1,9,0,3,8,10,#,#,2,5,#,#,#,#,#,#,4,6}");
+constexpr auto tree2=STATIC_TREE("{5,4,8,11,#,13,4,7,2,#,#,5,1}");
+constexpr auto empty=STATIC_TREE("{#}");
+
+static_assert(bst.Size()==11 && tree2.Size()==10 && empty.Size()==0,"wrong node count");
+static_assert(bst.IsBST() && !bst.HasLoop(),"bst must be a valid BST");
+static_assert(!tree2.IsBST() && !tree2.HasLoop(),"tree2 is not a BST");
+static_assert(tree2.HasPathSum(22) && !tree2.HasPathSum(23),"wrong path sum");
+static_assert(bst.val[bst.Lookup(5)]==5 && bst.Lookup(11)==bst.NIL,"wrong lookup");
+static_assert(bst.InorderTraversal()[0]==0 && bst.PreorderTraversal()[1]==1,"wrong traversal");
+static_assert(IsSameTree(bst,STATIC_TREE("7,1,9,0,3,8,10,#,#,2,5,#,#,#,#,#,#,4,6")),"same tree");
+static_assert(!IsSameTree(bst,tree2) && IsSameTree(empty,empty),"different trees");
+
+void PrintTrace(const char* name, vector<int> trace, vector<int> expected) {
+	cout<<name<<": ";
+	for(auto& v:trace)
+		cout<<v<<" ";
+	cout<<(trace==expected ? "(same as BinaryTree)" : "(WRONG)")<<endl;
+}
+
+int main() {
+	vector<string> tree={"5","4","8","11","#","13","4","7","2","#","#","5","1"};
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	cout<<"\nBinary Tree:"<<endl;
+	bt.PrintTree(t);
+
+	cout<<"\nStatic tree of "<<tree2.Size()<<" nodes, "<<sizeof(tree2)<<" bytes:"<<endl;
+	PrintTrace("Preorder",tree2.PreorderTraversal().ToVector(),bt.PreorderTraversal(t));
+	PrintTrace("Inorder",tree2.InorderTraversal().ToVector(),bt.InorderTraversal(t));
+	PrintTrace("Postorder",tree2.PostorderTraversal().ToVector(),bt.PostorderTraversal(t));
+
+	// Run time calls on the same arrays
+	for(int sum:{22,26,18,17})
+		cout<<"Path sum "<<sum<<": "<<(tree2.HasPathSum(sum) ? "found" : "not found")<<endl;
+
+	return 0;
+}
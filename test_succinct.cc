@@ -0,0 +1,41 @@
+#include <iostream>
+#include "succinct.h"
+
+using namespace std;
+
+int main() {
+	vector<string> tree={"7","1","9","0","3","8","10","#","#","2","5","#","#","#","#","#","#","4","6"};
+
+	cout<<"\nBinary Tree:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	bt.PrintTree(t);
+
+	LoudsTree lt(tree);
+	cout<<"\nLOUDS encoding: "<<lt.Size()<<" nodes in "<<lt.MemoryBytes()<<" bytes"<<endl;
+	vector<int> vec=lt.PreorderTraversal();
+	bt.PrintTraversal(vec,"Preorder");
+	vec=lt.InorderTraversal();
+	bt.PrintTraversal(vec,"Inorder");
+	vec=lt.PostorderTraversal();
+	bt.PrintTraversal(vec,"Postorder");
+	vector<vector<int> > tr=lt.ZigzagLevelOrder();
+	bt.PrintTraversal(tr,"Zigzag Order");
+
+	// Same encoding from the TreeNodes
+	LoudsTree lt2(t);
+	if(lt2.PreorderTraversal()==bt.PreorderTraversal(t) && lt2.InorderTraversal()==bt.InorderTraversal(t)
+			&& lt2.ZigzagLevelOrder()==bt.ZigzagLevelOrder(t))
+		cout<<"\nEncoding of the TreeNodes matches."<<endl;
+
+	cout<<"\nNavigation:"<<endl;
+	for(size_t i=0;i<lt.Size();++i) {
+		cout<<lt.Value(i)<<": parent ";
+		if(lt.Parent(i)!=LoudsTree::NIL) cout<<lt.Value(lt.Parent(i)); else cout<<"-";
+		cout<<", sibling ";
+		if(lt.Sibling(i)!=LoudsTree::NIL) cout<<lt.Value(lt.Sibling(i)); else cout<<"-";
+		cout<<", subtree size "<<lt.SubtreeSize(i)<<endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <new>
+#include "binarytree.h"
+
+using namespace std;
+
+// Count heap allocations
+static size_t allocations=0;
+void* operator new(size_t n) {
+	allocations++;
+	void* p=malloc(n);
+	if(p==NULL)
+		throw bad_alloc();
+	return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main() {
+	vector<string> tree={"7","1","9","0","3","8","10","#","#","2","5","#","#","#","#","#","#","4","6"};
+
+	cout<<"\nBinary Tree:"<<endl;
+	BinaryTree bt(tree);
+	TreeNode* t=bt.GetRoot();
+	bt.PrintTree(t);
+
+	// Workspace and output buffer are reused by all calls
+	TraversalWorkspace ws=bt.MakeWorkspace();
+	vector<int> buf(bt.TraceLength());
+	size_t before=allocations;
+	bool same=true, loop=false;
+	for(int i=0;i<1000;++i) {
+		bt.PreorderTraversal(t,ws,buf.begin());
+		bt.InorderTraversal(t,ws,buf.begin());
+		bt.PostorderTraversal(t,ws,buf.begin());
+		same=same && bt.IsSameTree(t,t,ws);
+		loop=loop || bt.HasLoop(t,ws);
+	}
+	size_t steady=allocations-before;
+
+	int* end=bt.InorderTraversal(t,ws,&buf[0]);
+	vector<int> vec(&buf[0],end);
+	bt.PrintTraversal(vec,"Inorder");
+	cout<<(same ? "Same tree" : "Different trees")<<", "<<(loop ? "loop found" : "no loop")<<endl;
+	cout<<"Allocations in 1000 rounds: "<<steady<<endl;
+
+	return 0;
+}